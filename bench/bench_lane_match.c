@@ -0,0 +1,110 @@
+/*! # bench_lane_match.c
+
+Microbenchmark of the search for a vehicle accepting a destination in a lane (see `src/lane_match.h`), at lane sizes
+much larger than the ones of the simulation.
+The only accepting vehicle is the last one, so every search scans the whole lane. The baseline follows a pointer
+per vehicle, like the lanes did before keeping packed keys.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/lane_match.h"
+
+#define BENCH_ROUNDS_SLOTS 100000000
+
+struct bench_vehicle {
+    size_t destination;
+    bool loading;
+    char padding[48];
+};
+
+typedef size_t (*lane_match_fn)(const lane_key_t*, size_t, size_t, lane_key_t, lane_key_t);
+
+double bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/// Returns the average time of a search, in nanoseconds
+double bench_keys(lane_match_fn match, const lane_key_t* keys, size_t n, size_t rounds) {
+    size_t found = 0;
+    double start = bench_now();
+    for (size_t r = 0; r < rounds; r++) {
+        found += match(keys, 0, n, LANE_KEY_DESTINATION | LANE_KEY_FULL, 0);
+        __asm__ volatile("" ::: "memory");
+    }
+    double elapsed = bench_now() - start;
+    if (found != rounds * (n - 1)) fprintf(stderr, "Unexpected match\n");
+    return elapsed / rounds * 1e9;
+}
+
+double bench_pointers(struct bench_vehicle* const* vehicles, size_t n, size_t rounds) {
+    size_t found = 0;
+    double start = bench_now();
+    for (size_t r = 0; r < rounds; r++) {
+        size_t i = 0;
+        while (i < n && !(vehicles[i]->loading && vehicles[i]->destination == 0)) i++;
+        found += i;
+        __asm__ volatile("" ::: "memory");
+    }
+    double elapsed = bench_now() - start;
+    if (found != rounds * (n - 1)) fprintf(stderr, "Unexpected match\n");
+    return elapsed / rounds * 1e9;
+}
+
+int main() {
+    static const size_t SIZES[] = {16, 64, 256, 1024, 4096, 16384, 65536};
+
+    printf("lane_match_next uses %s\n\n", lane_match_implementation());
+    printf("%8s %12s %12s %12s %12s\n", "SLOTS", "POINTERS", "SCALAR", "SSE2", "AVX2");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        size_t n = SIZES[s];
+        size_t rounds = BENCH_ROUNDS_SLOTS / n;
+
+        lane_key_t* keys = (lane_key_t*)calloc(lane_keys_size(n), sizeof(lane_key_t));
+        struct bench_vehicle* storage = (struct bench_vehicle*)calloc(n, sizeof(struct bench_vehicle));
+        struct bench_vehicle** vehicles = (struct bench_vehicle**)malloc(n * sizeof(struct bench_vehicle*));
+        if (keys == NULL || storage == NULL || vehicles == NULL) return 1;
+
+        // Every vehicle but the last one is either unloading, or loading for another destination
+        for (size_t i = 0; i < n; i++) {
+            size_t destination = i == n - 1 ? 0 : rand() % N_DESTINATIONS;
+            bool loading = i == n - 1 || (destination != 0 && rand() % 2 == 0);
+            keys[i] = lane_key(destination, !loading, loading);
+            storage[i].destination = destination;
+            storage[i].loading = loading;
+            vehicles[i] = &storage[i];
+        }
+        // Shuffled, like the trucks of a lane which were parked at different times
+        for (size_t i = n - 1; i > 1; i--) {
+            size_t j = rand() % i;
+            struct bench_vehicle* vehicle = vehicles[i - 1];
+            vehicles[i - 1] = vehicles[j];
+            vehicles[j] = vehicle;
+        }
+
+        printf("%8zu %9.1f ns", n, bench_pointers(vehicles, n, rounds));
+        printf(" %9.1f ns", bench_keys(lane_match_next_scalar, keys, n, rounds));
+#ifdef LANE_MATCH_X86
+        printf(" %9.1f ns", bench_keys(lane_match_next_sse2, keys, n, rounds));
+        if (__builtin_cpu_supports("avx2")) {
+            printf(" %9.1f ns", bench_keys(lane_match_next_avx2, keys, n, rounds));
+        } else {
+            printf(" %12s", "-");
+        }
+#else
+        printf(" %12s %12s", "-", "-");
+#endif
+        printf("\n");
+
+        free(keys);
+        free(storage);
+        free(vehicles);
+    }
+
+    return 0;
+}
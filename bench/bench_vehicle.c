@@ -0,0 +1,123 @@
+/*! # bench_vehicle.c
+
+Microbenchmark of the functions generated by `VEHICLE` (see `src/vehicle.h`), against the hand-written versions
+that boats and wagons used to have, on many vehicles loaded at random.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include "../src/boat.h"
+#include "../src/train.h"
+
+#define BENCH_VEHICLES 4096
+#define BENCH_ROUNDS 500
+#define BENCH_REPEATS 7
+
+double bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// The hand-written versions, as they were in boat.c and train.c
+
+bool handwritten_boat_is_full(boat_t* boat) {
+    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
+        if (container_holder_is_empty(&boat->containers[n])) return false;
+    }
+    return true;
+}
+
+size_t handwritten_boat_loaded(boat_t* boat) {
+    size_t res = 0;
+    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
+        if (!container_holder_is_empty(&boat->containers[n])) res += 1;
+    }
+    return res;
+}
+
+container_holder_t* handwritten_boat_first_empty(boat_t* boat) {
+    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
+        if (container_holder_is_empty(&boat->containers[n])) return &boat->containers[n];
+    }
+    return NULL;
+}
+
+bool handwritten_wagon_is_empty(wagon_t* wagon) {
+    for (size_t n = 0; n < WAGON_CONTAINERS; n++) {
+        if (!container_holder_is_empty(&wagon->containers[n])) return false;
+    }
+    return true;
+}
+
+size_t handwritten_wagon_loaded(wagon_t* wagon) {
+    size_t res = 0;
+    for (size_t n = 0; n < WAGON_CONTAINERS; n++) {
+        if (!container_holder_is_empty(&wagon->containers[n])) res += 1;
+    }
+    return res;
+}
+
+/// Runs `expression` (which may use `vehicle`) on every vehicle of `vehicles`, and returns the average time of a call,
+/// in nanoseconds; `checksum` accumulates the results, so that the calls can't be optimized out
+#define BENCH(vehicles, checksum, expression) ({ \
+    double start = bench_now(); \
+    for (size_t r = 0; r < BENCH_ROUNDS; r++) { \
+        for (size_t v = 0; v < BENCH_VEHICLES; v++) { \
+            __typeof__(&vehicles[0]) vehicle = &vehicles[v]; \
+            checksum += (size_t)(expression); \
+            __asm__ volatile("" ::: "memory"); \
+        } \
+    } \
+    (bench_now() - start) / ((double)BENCH_ROUNDS * BENCH_VEHICLES) * 1e9; \
+})
+
+/// Times both versions `BENCH_REPEATS` times, alternating between them, and prints the best time of each
+#define BENCH_PAIR(name, vehicles, handwritten, generic) do { \
+    size_t h = 0, g = 0; \
+    double th = INFINITY, tg = INFINITY; \
+    for (size_t repeat = 0; repeat < BENCH_REPEATS; repeat++) { \
+        th = fmin(th, BENCH(vehicles, h, handwritten)); \
+        tg = fmin(tg, BENCH(vehicles, g, generic)); \
+    } \
+    bench_print(name, th, h, tg, g); \
+} while (0)
+
+void bench_fill(container_holder_t* holders, size_t capacity) {
+    for (size_t n = 0; n < capacity; n++) {
+        holders[n].container.destination = rand() % 2 == 0 ? CONTAINER_NONE : rand() % N_DESTINATIONS;
+        holders[n].container.id = n;
+    }
+}
+
+void bench_print(const char* name, double handwritten, size_t handwritten_sum, double generic, size_t generic_sum) {
+    printf(
+        "%-18s %9.2f ns %9.2f ns %+7.1f%%%s\n",
+        name,
+        handwritten,
+        generic,
+        (generic / handwritten - 1.0) * 100.0,
+        handwritten_sum == generic_sum ? "" : "  (results differ!)"
+    );
+}
+
+int main() {
+    static boat_t boats[BENCH_VEHICLES];
+    static wagon_t wagons[BENCH_VEHICLES];
+    for (size_t v = 0; v < BENCH_VEHICLES; v++) {
+        bench_fill(boats[v].containers, BOAT_CONTAINERS);
+        bench_fill(wagons[v].containers, WAGON_CONTAINERS);
+    }
+
+    printf("%-18s %12s %12s %8s\n", "FUNCTION", "HANDWRITTEN", "VEHICLE", "DELTA");
+
+    BENCH_PAIR("boat_is_full", boats, handwritten_boat_is_full(vehicle), boat_is_full(vehicle));
+    BENCH_PAIR("boat_loaded", boats, handwritten_boat_loaded(vehicle), boat_loaded(vehicle));
+    BENCH_PAIR("boat_first_empty", boats, handwritten_boat_first_empty(vehicle), boat_first_empty(vehicle));
+    BENCH_PAIR("wagon_is_empty", wagons, handwritten_wagon_is_empty(vehicle), wagon_is_empty(vehicle));
+    BENCH_PAIR("wagon_loaded", wagons, handwritten_wagon_loaded(vehicle), wagon_loaded(vehicle));
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+# Compares a control tower with a single dispatcher with one running a dispatcher per lane: the throughput of the
+# cranes, and the turnaround of the trucks (the average time from their arrival to their departure)
+scenarios=(
+    ""
+    "--trucks poisson:1000 --boats poisson:200 --trains poisson:50 --duration 500"
+    "--terminals 3 --transfer"
+)
+
+for scenario in "${scenarios[@]}"; do
+    for mode in "" "--dispatchers"; do
+        for n in `seq 20`; do
+            ./build/sy40_project $mode $scenario
+        done | awk -v name="${scenario:-default} ${mode:---single}" '
+            /^Moves:/ { rate += $(NF - 1); runs++ }
+            /^Trucks .*latency:/ {
+                split($0, parts, "latency: ")
+                match($0, /[0-9]+ left/)
+                left = substr($0, RSTART, RLENGTH) + 0
+                latency += parts[2] * left
+                trucks += left
+            }
+            END { printf "%s: %.0f moves/s, trucks %.1f ms on average\n", name, rate / runs, (trucks > 0 ? latency / trucks : 0) }
+        '
+    done
+done
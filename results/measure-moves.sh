@@ -0,0 +1,22 @@
+# Compares the moves/s of the cache-aligned layout against the packed layout (NO_CACHE_ALIGN)
+for defines in "" "NO_CACHE_ALIGN"; do
+    make -j --always-make DEFINES="$defines" > /dev/null
+    total=0
+    runs=0
+    for n in `seq 40`; do
+        rate=`./build/sy40_project | grep "^Moves:" | sed 's/.*, \([0-9]*\) moves\/s/\1/'`
+        # A run that crashed or printed no moves is left out of the average
+        if [ -n "$rate" ]; then
+            total=$((total + rate))
+            runs=$((runs + 1))
+        fi
+    done
+    if [ $runs -gt 0 ]; then
+        echo "${defines:-CACHE_ALIGNED}: $((total / runs)) moves/s on average over $runs runs"
+    else
+        echo "${defines:-CACHE_ALIGNED}: no run reported its moves"
+    fi
+done
+
+# Leaves build/ with the default layout
+make -j --always-make > /dev/null
@@ -0,0 +1,36 @@
+# Compares prioritized queues with plain FIFO queues: the turnaround of the trucks (the average time from their arrival
+# to their departure), and how long the TRUCK_EMPTY and CRANE_STUCK messages waited in the queue of the control tower
+scenarios=(
+    ""
+    "--trucks poisson:1000 --boats poisson:200 --trains poisson:50 --duration 500"
+    "--dispatchers --trucks poisson:1000 --boats poisson:200 --trains poisson:50 --duration 500"
+)
+
+for scenario in "${scenarios[@]}"; do
+    for mode in "" "--fifo-queues"; do
+        for n in `seq 20`; do
+            ./build/sy40_project $mode $scenario
+        done | awk -v name="${scenario:-default} ${mode:---prioritized}" '
+            /^Trucks .*latency:/ {
+                split($0, parts, "latency: ")
+                match($0, /[0-9]+ left/)
+                left = substr($0, RSTART, RLENGTH) + 0
+                latency += parts[2] * left
+                trucks += left
+            }
+            /^Queue gamma:/ {
+                for (i = 1; i <= NF; i++) {
+                    if ($i == "TRUCK_EMPTY:" || $i == "CRANE_STUCK:") {
+                        count[$i] += $(i + 1)
+                        wait[$i] += $(i + 1) * $(i + 3)
+                    }
+                }
+            }
+            END {
+                printf "%s: trucks %.1f ms on average", name, (trucks > 0 ? latency / trucks : 0)
+                printf ", TRUCK_EMPTY waited %.3f ms", (count["TRUCK_EMPTY:"] > 0 ? wait["TRUCK_EMPTY:"] / count["TRUCK_EMPTY:"] : 0)
+                printf ", CRANE_STUCK waited %.3f ms\n", (count["CRANE_STUCK:"] > 0 ? wait["CRANE_STUCK:"] / count["CRANE_STUCK:"] : 0)
+            }
+        '
+    done
+done
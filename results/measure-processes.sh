@@ -0,0 +1,21 @@
+# Compares the throughput of agents running as threads with the one of agents running as processes
+# sharing the platform through shared memory
+for terminals in 1 3; do
+    for mode in "" "--processes"; do
+        total=0
+        runs=0
+        for n in `seq 20`; do
+            rate=`./build/sy40_project --terminals $terminals $mode | grep "^Moves:" | tail -n 1 | sed 's/.*, \([0-9]*\) moves\/s/\1/'`
+            # A run that crashed or printed no moves is left out of the average
+            if [ -n "$rate" ]; then
+                total=$((total + rate))
+                runs=$((runs + 1))
+            fi
+        done
+        if [ $runs -gt 0 ]; then
+            echo "$terminals terminals ${mode:---threads}: $((total / runs)) moves/s on average over $runs runs"
+        else
+            echo "$terminals terminals ${mode:---threads}: no run reported its moves"
+        fi
+    done
+done
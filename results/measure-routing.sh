@@ -0,0 +1,33 @@
+# Compares the routing policies of the cranes (see src/routing.h) on a few scenarios: the throughput of the cranes,
+# and the turnaround of the vehicles (the average time from their arrival to their departure, over the vehicles that left)
+runs=${runs:-10}
+scenarios=(
+    ""
+    "--trucks poisson:200 --boats poisson:50 --trains poisson:20 --duration 500"
+    "--terminals 3 --transfer"
+)
+
+for scenario in "${scenarios[@]}"; do
+    echo "${scenario:-default}"
+    for policy in fixed fullest departure boat-dwell random; do
+        for n in `seq $runs`; do
+            ./build/sy40_project --routing $policy $scenario 2>&1
+        done | awk -v policy=$policy -v runs=$runs '
+            /^Moves:/ { rate += $(NF - 1) }
+            /^Terminal [0-9]+ Moves:/ { next }
+            /latency:/ {
+                kind = $1
+                split($0, parts, "latency: ")
+                match($0, /[0-9]+ left/)
+                left = substr($0, RSTART, RLENGTH) + 0
+                sum[kind] += parts[2] * left
+                count[kind] += left
+            }
+            END {
+                printf "  %-10s %6.0f moves/s", policy, rate / runs
+                for (kind in sum) printf ", %s %.1f ms", kind, (count[kind] > 0 ? sum[kind] / count[kind] : 0)
+                printf "\n"
+            }
+        '
+    done
+done
@@ -0,0 +1,8 @@
+# Sweeps the arrival rate of the trucks to find the saturation point of the platform:
+# past it, trucks keep piling up in the backlog and their latency grows with the duration of the run
+for rate in 10 20 50 100 200 500 1000; do
+    echo "poisson:$rate"
+    for n in `seq 5`; do
+        ./build/sy40_project --trucks poisson:$rate --duration 500 | grep "^Trucks"
+    done
+done
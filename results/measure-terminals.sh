@@ -0,0 +1,21 @@
+# Measures how the platform scales with the number of terminals, with independent terminals and with terminals
+# sending each other the containers whose destination they don't serve
+for terminals in 1 2 3 4 5; do
+    for transfer in "" "--transfer"; do
+        total=0
+        runs=0
+        for n in `seq 20`; do
+            rate=`./build/sy40_project --terminals $terminals $transfer | grep "^Moves:" | tail -n 1 | sed 's/.*, \([0-9]*\) moves\/s/\1/'`
+            # A run that crashed or printed no moves is left out of the average
+            if [ -n "$rate" ]; then
+                total=$((total + rate))
+                runs=$((runs + 1))
+            fi
+        done
+        if [ $runs -gt 0 ]; then
+            echo "$terminals terminals ${transfer:---independent}: $((total / runs)) moves/s on average over $runs runs"
+        else
+            echo "$terminals terminals ${transfer:---independent}: no run reported its moves"
+        fi
+    done
+done
@@ -0,0 +1,21 @@
+# Compares the routing policies of the cranes under the physical timing model (see src/timing.h): the simulated time
+# per move (the makespan divided by the number of moves, as runs don't move the same number of containers), and the
+# utilisation of each crane
+runs=${runs:-10}
+
+for policy in fixed fullest departure boat-dwell random; do
+    for n in `seq $runs`; do
+        ./build/sy40_project --timing --routing $policy 2>&1
+    done | awk -v policy=$policy '
+        /^Moves:/ { moves += $2 }
+        /^Timing:/ {
+            makespan += $3
+            alpha += $9
+            beta += $18
+            runs++
+        }
+        END {
+            printf "%-10s %6.1f s/move, alpha %3.0f%%, beta %3.0f%%\n", policy, (moves > 0 ? makespan / moves : 0), alpha / runs, beta / runs
+        }
+    '
+done
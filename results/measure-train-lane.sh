@@ -0,0 +1,24 @@
+# Measures how long the train lanes are held, and how often locking them has to wait
+make -j --always-make DEFINES="TRAIN_LANE_HOLD_TIME" > /dev/null 2>&1
+for mode in "" "--processes" "--terminals 3 --transfer"; do
+    for n in `seq 40`; do
+        ./build/sy40_project $mode | grep "Train lane"
+    done | awk -v mode="${mode:-default}" '
+        {
+            for (i = 1; $i != "lane"; i++);
+            lane = $(i + 1)
+            waits[lane] += $(i + 2)
+            holds[lane] += $(i + 6)
+            held[lane] += $(i + 6) * $(i + 9)
+            if ($(i + 13) > max[lane]) max[lane] = $(i + 13)
+        }
+        END {
+            for (lane in waits) {
+                printf "%s: %s %d lock waits, held for %.3f us on average, %.1f ms in total, %.3f us at most\n", mode, lane, waits[lane], (holds[lane] > 0 ? held[lane] / holds[lane] : 0), held[lane] / 1000, max[lane]
+            }
+        }
+    '
+done
+
+# Leaves build/ without the measurement
+make -j --always-make > /dev/null 2>&1
@@ -0,0 +1,16 @@
+# Compares the platform without a yard with yards of increasing heights (see src/yard.h): the number of containers
+# moved onto a vehicle per run (leaving out the moves into the yard, which only stage containers), the throughput of the
+# cranes, and how many containers went through the yard
+runs=${runs:-10}
+
+for height in 0 1 2 4 8 16; do
+    for n in `seq $runs`; do
+        ./build/sy40_project --yard $height 2>&1
+    done | awk -v height=$height -v runs=$runs '
+        /^Moves:/ { moves += $2; rate += $(NF - 1) }
+        /^Yard / { staged += $3 }
+        END {
+            printf "yard %2d: %6.1f containers moved, %6.0f moves/s, %5.1f staged per run\n", height, (moves - staged) / runs, rate / runs, staged / runs
+        }
+    '
+done
@@ -0,0 +1,66 @@
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "assert.h"
+#include "shared_memory.h"
+
+static cpu_set_t initial_cpus;
+static pthread_once_t initial_cpus_once = PTHREAD_ONCE_INIT;
+
+/// Saves the CPUs that the program may run on, before any thread gets pinned
+void save_initial_cpus() {
+    CPU_ZERO(&initial_cpus);
+    passert_eq(int, "%d", sched_getaffinity(0, sizeof(cpu_set_t), &initial_cpus), 0);
+}
+
+void pin_current_thread(int cpu) {
+    pthread_once(&initial_cpus_once, save_initial_cpus);
+    if (cpu < 0) return;
+
+    passert_lt(int, "%d", cpu, CPU_SETSIZE, "CPU index is too large");
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+
+    passert_eq(
+        int, "%d",
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus), 0,
+        "Couldn't pin thread to CPU %d", cpu
+    );
+}
+
+void unpin_current_thread() {
+    pthread_once(&initial_cpus_once, save_initial_cpus);
+    passert_eq(int, "%d", pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &initial_cpus), 0);
+}
+
+void* alloc_on_cpu(int cpu, size_t size) {
+    pin_current_thread(cpu);
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t rounded = (size + page - 1) / page * page;
+
+    void* res = shared_aligned_alloc(page, rounded);
+    // First touch, while pinned
+    memset(res, 0, rounded);
+
+    return res;
+}
+
+cpu_tracker_t new_cpu_tracker() {
+    cpu_tracker_t res;
+    res.cpu = -1;
+    res.migrations = 0;
+    return res;
+}
+
+void cpu_tracker_update(cpu_tracker_t* tracker) {
+    int cpu = sched_getcpu();
+    if (cpu < 0) return;
+
+    if (tracker->cpu >= 0 && tracker->cpu != cpu) tracker->migrations++;
+    tracker->cpu = cpu;
+}
@@ -0,0 +1,38 @@
+/*! # affinity.h
+
+Placement of the agents on the CPUs: pinning threads, allocating an agent's memory on the NUMA node of its CPU
+and counting how often a thread migrates from one CPU to another.
+
+NUMA placement relies on the kernel's first-touch policy: memory gets allocated on the node of the CPU that first writes to it,
+so an agent's memory is allocated and initialized while the calling thread is pinned to that agent's CPU.
+*/
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdlib.h>
+
+/// Pins the calling thread to `cpu`; does nothing if `cpu` is negative
+void pin_current_thread(int cpu);
+
+/// Lets the calling thread run on any of the CPUs it could run on when the program started
+void unpin_current_thread();
+
+/// Pins the calling thread to `cpu` (if it isn't negative) and allocates `size` zeroed, page-aligned bytes.
+/// The memory should be initialized before calling `unpin_current_thread` for it to be placed on the NUMA node of `cpu`
+void* alloc_on_cpu(int cpu, size_t size);
+
+/// Counts the migrations of a thread; it is sampled by the thread itself
+struct cpu_tracker {
+    /// The CPU on which the thread was last seen, or -1 if it wasn't sampled yet
+    int cpu;
+    size_t migrations;
+};
+typedef struct cpu_tracker cpu_tracker_t;
+
+cpu_tracker_t new_cpu_tracker();
+
+/// Samples the CPU that the calling thread runs on, counting a migration if it changed since the last call
+void cpu_tracker_update(cpu_tracker_t* tracker);
+
+#endif // AFFINITY_H
@@ -0,0 +1,359 @@
+#include "arrival_log.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "shared_memory.h"
+
+/// Large enough for any record
+#define ARRIVAL_RECORD_SIZE 512
+
+/// Sequential reader/writer over the bytes of a record
+struct arrival_cursor {
+    unsigned char* data;
+    size_t offset;
+    size_t size;
+};
+
+/// Returns a pointer to the next `size` bytes and advances the cursor
+unsigned char* arrival_take(struct arrival_cursor* cursor, size_t size) {
+    passert_lte(size_t, "%zu", cursor->offset + size, cursor->size, "Arrival log is truncated");
+    unsigned char* res = cursor->data + cursor->offset;
+    cursor->offset += size;
+    return res;
+}
+
+void arrival_put_byte(struct arrival_cursor* cursor, size_t value) {
+    passert_lt(size_t, "%zu", value, 256);
+    *arrival_take(cursor, 1) = (unsigned char)value;
+}
+
+size_t arrival_get_byte(struct arrival_cursor* cursor) {
+    return *arrival_take(cursor, 1);
+}
+
+size_t arrival_get_destination(struct arrival_cursor* cursor) {
+    size_t res = arrival_get_byte(cursor);
+    passert_lt(size_t, "%zu", res, N_DESTINATIONS, "Invalid destination in arrival log");
+    return res;
+}
+
+void arrival_put_container(struct arrival_cursor* cursor, const container_holder_t* holder) {
+    if (container_holder_is_empty(holder)) {
+        arrival_put_byte(cursor, ARRIVAL_LOG_EMPTY);
+    } else {
+        arrival_put_byte(cursor, holder->container.destination);
+        memcpy(arrival_take(cursor, 16), container_ulid(&holder->container), 16);
+    }
+}
+
+void arrival_get_container(struct arrival_cursor* cursor, container_holder_t* holder) {
+    size_t destination = arrival_get_byte(cursor);
+    if (destination == ARRIVAL_LOG_EMPTY) {
+        *holder = new_container_holder(true, 0);
+    } else {
+        passert_lt(size_t, "%zu", destination, N_DESTINATIONS, "Invalid destination in arrival log");
+        holder->container = restore_container(destination, arrival_take(cursor, 16));
+    }
+}
+
+void arrival_get_truck(struct arrival_cursor* cursor, truck_t* truck, size_t* crane) {
+    *crane = arrival_get_byte(cursor);
+    passert_lt(size_t, "%zu", *crane, 2, "Invalid crane in arrival log");
+    truck->destination = arrival_get_destination(cursor);
+    truck->loading = arrival_get_byte(cursor) != 0;
+    for (size_t n = 0; n < TRUCK_CONTAINERS; n++) {
+        arrival_get_container(cursor, &truck->containers[n]);
+    }
+    memcpy(truck->ulid, arrival_take(cursor, 16), 16);
+}
+
+void arrival_get_boat(struct arrival_cursor* cursor, boat_t* boat) {
+    boat->destination = arrival_get_destination(cursor);
+    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
+        arrival_get_container(cursor, &boat->containers[n]);
+    }
+    memcpy(boat->ulid, arrival_take(cursor, 16), 16);
+}
+
+void arrival_get_train(struct arrival_cursor* cursor, train_t* train) {
+    train->destination = arrival_get_destination(cursor);
+    train->n_wagons = arrival_get_byte(cursor);
+    passert_lte(size_t, "%zu", train->n_wagons, TRAIN_WAGONS, "Invalid train in arrival log");
+
+    for (size_t n = 0; n < train->n_wagons; n++) {
+        wagon_t* wagon = &train->wagons[n];
+        wagon->train = train;
+        wagon->destination = train->destination;
+        for (size_t c = 0; c < WAGON_CONTAINERS; c++) {
+            arrival_get_container(cursor, &wagon->containers[c]);
+        }
+        memcpy(wagon->ulid, arrival_take(cursor, 16), 16);
+
+        train->wagon_full[n] = false;
+        // Same as in init_train
+        train->wagon_empty[n] = wagon_is_empty(wagon);
+    }
+
+    train->offset = 0;
+}
+
+/// Checks the container written by `arrival_put_container` and skips it, without creating the container
+void arrival_skip_container(struct arrival_cursor* cursor) {
+    size_t destination = arrival_get_byte(cursor);
+    if (destination == ARRIVAL_LOG_EMPTY) return;
+
+    passert_lt(size_t, "%zu", destination, N_DESTINATIONS, "Invalid destination in arrival log");
+    arrival_take(cursor, 16);
+}
+
+/// Checks a truck record and skips it; same layout as read by `arrival_get_truck`
+void arrival_skip_truck(struct arrival_cursor* cursor) {
+    passert_lt(size_t, "%zu", arrival_get_byte(cursor), 2, "Invalid crane in arrival log");
+    arrival_get_destination(cursor);
+    arrival_get_byte(cursor);
+    for (size_t n = 0; n < TRUCK_CONTAINERS; n++) {
+        arrival_skip_container(cursor);
+    }
+    arrival_take(cursor, 16);
+}
+
+/// Checks a boat record and skips it; same layout as read by `arrival_get_boat`
+void arrival_skip_boat(struct arrival_cursor* cursor) {
+    arrival_get_destination(cursor);
+    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
+        arrival_skip_container(cursor);
+    }
+    arrival_take(cursor, 16);
+}
+
+/// Checks a train record and skips it; same layout as read by `arrival_get_train`
+void arrival_skip_train(struct arrival_cursor* cursor) {
+    arrival_get_destination(cursor);
+    size_t n_wagons = arrival_get_byte(cursor);
+    passert_lte(size_t, "%zu", n_wagons, TRAIN_WAGONS, "Invalid train in arrival log");
+
+    for (size_t n = 0; n < n_wagons; n++) {
+        for (size_t c = 0; c < WAGON_CONTAINERS; c++) {
+            arrival_skip_container(cursor);
+        }
+        arrival_take(cursor, 16);
+    }
+}
+
+arrival_log_t* new_arrival_log(bool replay) {
+    // The counters are updated by the control tower, which may run in another process (see `shared_memory.h`)
+    arrival_log_t* res = (arrival_log_t*)shared_calloc(1, sizeof(arrival_log_t));
+    passert_neq(arrival_log_t*, "%p", res, NULL);
+    res->replay = replay;
+    return res;
+}
+
+arrival_log_t* arrival_log_record(const char* path) {
+    arrival_log_t* res = new_arrival_log(false);
+
+    res->file = fopen(path, "wb");
+    passert_neq(FILE*, "%p", res->file, NULL, "Couldn't create arrival log %s", path);
+
+    struct arrival_log_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ARRIVAL_LOG_MAGIC;
+    header.version = ARRIVAL_LOG_VERSION;
+    header.boat_containers = BOAT_CONTAINERS;
+    header.wagon_containers = WAGON_CONTAINERS;
+    header.train_wagons = TRAIN_WAGONS;
+    header.n_destinations = N_DESTINATIONS;
+    passert_eq(size_t, "%zu", fwrite(&header, sizeof(header), 1, res->file), 1);
+
+    return res;
+}
+
+arrival_log_t* arrival_log_replay(const char* path) {
+    arrival_log_t* res = new_arrival_log(true);
+
+    int fd = open(path, O_RDONLY);
+    passert_gte(int, "%d", fd, 0, "Couldn't open arrival log %s", path);
+    struct stat st;
+    passert_eq(int, "%d", fstat(fd, &st), 0);
+    res->size = st.st_size;
+    passert_gte(size_t, "%zu", res->size, sizeof(struct arrival_log_header), "Arrival log %s is truncated", path);
+    res->data = mmap(NULL, res->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    passert_neq(void*, "%p", res->data, MAP_FAILED);
+    close(fd);
+
+    struct arrival_log_header header;
+    memcpy(&header, res->data, sizeof(header));
+    passert_eq(uint32_t, "%" PRIu32, header.magic, ARRIVAL_LOG_MAGIC, "%s isn't an arrival log", path);
+    passert_eq(uint32_t, "%" PRIu32, header.version, ARRIVAL_LOG_VERSION, "Unsupported arrival log version");
+    passert(
+        header.boat_containers == BOAT_CONTAINERS
+            && header.wagon_containers == WAGON_CONTAINERS
+            && header.train_wagons == TRAIN_WAGONS
+            && header.n_destinations == N_DESTINATIONS,
+        "Arrival log %s was recorded by a build with a different layout", path
+    );
+
+    // Index the records of each kind, validating them along the way; the containers are only created once replayed
+    size_t capacity[N_ARRIVAL_KINDS];
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        capacity[k] = 16;
+        res->records[k] = (size_t*)malloc(capacity[k] * sizeof(size_t));
+        passert_neq(size_t*, "%p", res->records[k], NULL);
+    }
+
+    struct arrival_cursor cursor = {res->data, sizeof(header), res->size};
+    while (cursor.offset < cursor.size) {
+        size_t offset = cursor.offset;
+        size_t kind = arrival_get_byte(&cursor);
+
+        switch (kind) {
+            case ARRIVAL_TRUCK:
+                arrival_skip_truck(&cursor);
+                break;
+            case ARRIVAL_BOAT:
+                arrival_skip_boat(&cursor);
+                break;
+            case ARRIVAL_TRAIN:
+                arrival_skip_train(&cursor);
+                break;
+            default:
+                passert(false, "Invalid record at offset %zu of arrival log %s", offset, path);
+        }
+
+        if (res->n_records[kind] == capacity[kind]) {
+            capacity[kind] *= 2;
+            res->records[kind] = (size_t*)realloc(res->records[kind], capacity[kind] * sizeof(size_t));
+            passert_neq(size_t*, "%p", res->records[kind], NULL);
+        }
+        // Records are indexed past their kind
+        res->records[kind][res->n_records[kind]++] = offset + 1;
+    }
+
+    printf(
+        "Arrivals <= %s (%zu trucks, %zu boats, %zu trains)\n",
+        path,
+        res->n_records[ARRIVAL_TRUCK],
+        res->n_records[ARRIVAL_BOAT],
+        res->n_records[ARRIVAL_TRAIN]
+    );
+
+    return res;
+}
+
+void arrival_log_close(arrival_log_t* log) {
+    if (log->replay) {
+        printf(
+            "Arrivals replayed: %zu/%zu trucks, %zu/%zu boats, %zu/%zu trains\n",
+            log->n_replayed[ARRIVAL_TRUCK], log->n_records[ARRIVAL_TRUCK],
+            log->n_replayed[ARRIVAL_BOAT], log->n_records[ARRIVAL_BOAT],
+            log->n_replayed[ARRIVAL_TRAIN], log->n_records[ARRIVAL_TRAIN]
+        );
+        munmap(log->data, log->size);
+        for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+            free(log->records[k]);
+        }
+    } else {
+        printf(
+            "Arrivals recorded: %zu trucks, %zu boats, %zu trains\n",
+            log->n_recorded[ARRIVAL_TRUCK],
+            log->n_recorded[ARRIVAL_BOAT],
+            log->n_recorded[ARRIVAL_TRAIN]
+        );
+        passert_eq(int, "%d", fclose(log->file), 0);
+    }
+    shared_free(log);
+}
+
+/// Appends `record` to the log
+void arrival_log_append(arrival_log_t* log, enum arrival_kind kind, struct arrival_cursor* record) {
+    passert_eq(size_t, "%zu", fwrite(record->data, record->offset, 1, log->file), 1);
+    log->n_recorded[kind]++;
+}
+
+void arrival_log_write_truck(arrival_log_t* log, const truck_t* truck, size_t crane) {
+    if (log == NULL || log->replay) return;
+
+    unsigned char buffer[ARRIVAL_RECORD_SIZE];
+    struct arrival_cursor record = {buffer, 0, ARRIVAL_RECORD_SIZE};
+    arrival_put_byte(&record, ARRIVAL_TRUCK);
+    arrival_put_byte(&record, crane);
+    arrival_put_byte(&record, truck->destination);
+    arrival_put_byte(&record, truck->loading);
+    for (size_t n = 0; n < TRUCK_CONTAINERS; n++) {
+        arrival_put_container(&record, &truck->containers[n]);
+    }
+    memcpy(arrival_take(&record, 16), truck->ulid, 16);
+
+    arrival_log_append(log, ARRIVAL_TRUCK, &record);
+}
+
+void arrival_log_write_boat(arrival_log_t* log, const boat_t* boat) {
+    if (log == NULL || log->replay) return;
+
+    unsigned char buffer[ARRIVAL_RECORD_SIZE];
+    struct arrival_cursor record = {buffer, 0, ARRIVAL_RECORD_SIZE};
+    arrival_put_byte(&record, ARRIVAL_BOAT);
+    arrival_put_byte(&record, boat->destination);
+    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
+        arrival_put_container(&record, &boat->containers[n]);
+    }
+    memcpy(arrival_take(&record, 16), boat->ulid, 16);
+
+    arrival_log_append(log, ARRIVAL_BOAT, &record);
+}
+
+void arrival_log_write_train(arrival_log_t* log, const train_t* train) {
+    if (log == NULL || log->replay) return;
+
+    unsigned char buffer[ARRIVAL_RECORD_SIZE];
+    struct arrival_cursor record = {buffer, 0, ARRIVAL_RECORD_SIZE};
+    arrival_put_byte(&record, ARRIVAL_TRAIN);
+    arrival_put_byte(&record, train->destination);
+    arrival_put_byte(&record, train->n_wagons);
+    for (size_t n = 0; n < train->n_wagons; n++) {
+        for (size_t c = 0; c < WAGON_CONTAINERS; c++) {
+            arrival_put_container(&record, &train->wagons[n].containers[c]);
+        }
+        memcpy(arrival_take(&record, 16), train->wagons[n].ulid, 16);
+    }
+
+    arrival_log_append(log, ARRIVAL_TRAIN, &record);
+}
+
+/// Returns a cursor over the next record of the given kind, or false if there is none left
+bool arrival_log_next(arrival_log_t* log, enum arrival_kind kind, struct arrival_cursor* cursor) {
+    if (log == NULL || !log->replay || log->n_replayed[kind] == log->n_records[kind]) return false;
+
+    cursor->data = log->data;
+    cursor->offset = log->records[kind][log->n_replayed[kind]];
+    cursor->size = log->size;
+    log->n_replayed[kind]++;
+
+    return true;
+}
+
+bool arrival_log_read_truck(arrival_log_t* log, truck_t* truck, size_t* crane) {
+    struct arrival_cursor cursor;
+    if (!arrival_log_next(log, ARRIVAL_TRUCK, &cursor)) return false;
+
+    arrival_get_truck(&cursor, truck, crane);
+    return true;
+}
+
+bool arrival_log_read_boat(arrival_log_t* log, boat_t* boat) {
+    struct arrival_cursor cursor;
+    if (!arrival_log_next(log, ARRIVAL_BOAT, &cursor)) return false;
+
+    arrival_get_boat(&cursor, boat);
+    return true;
+}
+
+bool arrival_log_read_train(arrival_log_t* log, train_t* train) {
+    struct arrival_cursor cursor;
+    if (!arrival_log_next(log, ARRIVAL_TRAIN, &cursor)) return false;
+
+    arrival_get_train(&cursor, train);
+    return true;
+}
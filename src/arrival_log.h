@@ -0,0 +1,92 @@
+/*! # arrival_log.h
+
+Recording and replay of the vehicles that arrive on the platform.
+
+When recording, every truck, boat and train generated by the control tower is appended to a compact binary log,
+alongside the destinations and the ULIDs of its cargo. When replaying, the tower takes its vehicles from such a log
+instead of generating them, so that two runs get the exact same arrivals.
+Vehicles are replayed in the order in which they were recorded for each kind of vehicle; once the log runs out of
+vehicles of a kind, new ones are generated randomly again.
+
+Only the control tower may use the log (or main, before the agents are started), so it isn't protected by a mutex.
+With one dispatcher per lane (see `control_tower.h`), each kind of vehicle is only read or recorded by its own dispatcher,
+and every record is written with a single `fwrite`, so that records of different kinds don't get interleaved.
+*/
+
+#ifndef ARRIVAL_LOG_H
+#define ARRIVAL_LOG_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "truck.h"
+#include "boat.h"
+#include "train.h"
+
+#define ARRIVAL_LOG_MAGIC 0x5359414c
+#define ARRIVAL_LOG_VERSION 1
+
+/// Stored in place of the destination of an empty container holder, which is then only one byte long
+#define ARRIVAL_LOG_EMPTY 0xff
+
+enum arrival_kind {
+    ARRIVAL_TRUCK,
+    ARRIVAL_BOAT,
+    ARRIVAL_TRAIN,
+};
+#define N_ARRIVAL_KINDS 3
+
+struct arrival_log_header {
+    uint32_t magic;
+    uint32_t version;
+
+    /// Layout of the vehicles, which must match the one of the build replaying the log
+    uint8_t boat_containers;
+    uint8_t wagon_containers;
+    uint8_t train_wagons;
+    uint8_t n_destinations;
+};
+
+/// The log is a header followed by records, each of which starts with its `arrival_kind` (one byte):
+/// - a truck is its crane (0 for α, 1 for β), its destination, whether it is loading, its containers and its ULID
+/// - a boat is its destination, its containers and its ULID
+/// - a train is its destination, its number of wagons, and the containers and ULID of each wagon
+/// A container is its destination, followed by its ULID unless it is `ARRIVAL_LOG_EMPTY`
+struct arrival_log {
+    bool replay;
+
+    /// The log being recorded
+    FILE* file;
+    size_t n_recorded[N_ARRIVAL_KINDS];
+
+    /// The log being replayed, and the offsets of its records for each kind of vehicle
+    unsigned char* data;
+    size_t size;
+    size_t* records[N_ARRIVAL_KINDS];
+    size_t n_records[N_ARRIVAL_KINDS];
+    size_t n_replayed[N_ARRIVAL_KINDS];
+};
+typedef struct arrival_log arrival_log_t;
+
+/// Creates the log at `path`, into which the arrivals will be recorded
+arrival_log_t* arrival_log_record(const char* path);
+
+/// Opens the log at `path`, from which the arrivals will be replayed
+arrival_log_t* arrival_log_replay(const char* path);
+
+/// Flushes and closes the log, prints how many arrivals were recorded or replayed
+void arrival_log_close(arrival_log_t* log);
+
+/// Each of these functions does nothing if `log` is NULL or isn't being recorded.
+/// `crane` is 0 if the truck arrives at crane α and 1 if it arrives at crane β
+void arrival_log_write_truck(arrival_log_t* log, const truck_t* truck, size_t crane);
+void arrival_log_write_boat(arrival_log_t* log, const boat_t* boat);
+void arrival_log_write_train(arrival_log_t* log, const train_t* train);
+
+/// Each of these functions returns false if `log` is NULL, isn't being replayed or has no vehicle of that kind left;
+/// otherwise the next vehicle is written in place
+bool arrival_log_read_truck(arrival_log_t* log, truck_t* truck, size_t* crane);
+bool arrival_log_read_boat(arrival_log_t* log, boat_t* boat);
+bool arrival_log_read_train(arrival_log_t* log, train_t* train);
+
+#endif // ARRIVAL_LOG_H
@@ -0,0 +1,252 @@
+#include "arrival_process.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "assert.h"
+#include "shared_memory.h"
+
+double arrival_clock() {
+    struct timespec now;
+    passert_eq(int, "%d", clock_gettime(CLOCK_MONOTONIC, &now), 0);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+arrival_process_t new_arrival_process() {
+    arrival_process_t res;
+    memset(&res, 0, sizeof(res));
+
+    res.type = ARRIVAL_REPLACE;
+    res.next = INFINITY;
+
+    return res;
+}
+
+/// Parses a strictly positive number, returns false if `arg` isn't one
+bool parse_positive(const char* arg, double* res) {
+    char* end;
+    *res = strtod(arg, &end);
+    return *arg != '\0' && *end == '\0' && *res > 0 && isfinite(*res);
+}
+
+/// Reads the arrival times of a trace, returns false if the file can't be read or isn't sorted
+bool read_trace(const char* path, arrival_process_t* res) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return false;
+
+    size_t capacity = 64;
+    res->trace = (double*)shared_malloc(capacity * sizeof(double));
+    passert_neq(double*, "%p", res->trace, NULL);
+
+    double time;
+    bool valid = true;
+    while (valid && fscanf(file, "%lf", &time) == 1) {
+        if (res->n_trace == capacity) {
+            capacity *= 2;
+            res->trace = (double*)shared_realloc(res->trace, capacity * sizeof(double));
+            passert_neq(double*, "%p", res->trace, NULL);
+        }
+        valid = time >= 0 && (res->n_trace == 0 || time >= res->trace[res->n_trace - 1] * 1000.0);
+        res->trace[res->n_trace++] = time / 1000.0;
+    }
+    valid = valid && feof(file);
+
+    fclose(file);
+    return valid;
+}
+
+bool parse_arrival_process(const char* spec, arrival_process_t* res) {
+    *res = new_arrival_process();
+
+    if (strcmp(spec, "replace") == 0) {
+        return true;
+    } else if (strncmp(spec, "poisson:", 8) == 0) {
+        res->type = ARRIVAL_POISSON;
+        return parse_positive(spec + 8, &res->rate);
+    } else if (strncmp(spec, "onoff:", 6) == 0) {
+        res->type = ARRIVAL_ON_OFF;
+
+        char buffer[256];
+        if (strlen(spec + 6) >= sizeof(buffer)) return false;
+        strcpy(buffer, spec + 6);
+
+        char* rate = strtok(buffer, ":");
+        char* on = strtok(NULL, ":");
+        char* off = strtok(NULL, ":");
+        if (rate == NULL || on == NULL || off == NULL || strtok(NULL, ":") != NULL) return false;
+
+        bool valid = parse_positive(rate, &res->rate) && parse_positive(on, &res->on) && parse_positive(off, &res->off);
+        res->on /= 1000.0;
+        res->off /= 1000.0;
+        return valid;
+    } else if (strncmp(spec, "trace:", 6) == 0) {
+        res->type = ARRIVAL_TRACE;
+        return read_trace(spec + 6, res);
+    }
+
+    return false;
+}
+
+void free_arrival_process(arrival_process_t* process) {
+    shared_free(process->trace);
+    shared_free(process->backlog);
+}
+
+bool arrival_process_timed(const arrival_process_t* process) {
+    return process->type != ARRIVAL_REPLACE;
+}
+
+/// Returns an exponentially distributed delay, with a mean of 1/rate
+double arrival_delay(arrival_process_t* process) {
+    double uniform = rand_r(&process->seed) / ((double)RAND_MAX + 1.0);
+    return -log(1.0 - uniform) / process->rate;
+}
+
+/// Computes the time of the arrival following the one at `from`
+void arrival_process_schedule(arrival_process_t* process, double from) {
+    double next = INFINITY;
+
+    switch (process->type) {
+        case ARRIVAL_REPLACE:
+            break;
+        case ARRIVAL_POISSON:
+            next = from + arrival_delay(process);
+            break;
+        case ARRIVAL_ON_OFF: {
+            double period = process->on + process->off;
+            next = from + arrival_delay(process);
+            // Arrivals are memoryless, so a delay that ends during an off period is drawn again from the next on period
+            while (next <= process->end && fmod(next, period) >= process->on) {
+                next = next - fmod(next, period) + period + arrival_delay(process);
+            }
+            break;
+        }
+        case ARRIVAL_TRACE:
+            if (process->trace_index < process->n_trace) {
+                next = process->trace[process->trace_index++];
+            }
+            break;
+    }
+
+    process->next = next <= process->end ? next : INFINITY;
+}
+
+void arrival_process_start(arrival_process_t* process, double now, double end) {
+    process->end = end;
+    process->seed = rand();
+
+    // Trace times are absolute, the other processes start now
+    process->trace_index = 0;
+    arrival_process_schedule(process, now);
+}
+
+/// Appends a vehicle that was due at `time` to the backlog
+void arrival_process_push(arrival_process_t* process, double time) {
+    if (process->n_backlog == process->backlog_capacity) {
+        size_t capacity = process->backlog_capacity == 0 ? 16 : process->backlog_capacity * 2;
+        double* backlog = (double*)shared_malloc(capacity * sizeof(double));
+        passert_neq(double*, "%p", backlog, NULL);
+
+        for (size_t n = 0; n < process->n_backlog; n++) {
+            backlog[n] = process->backlog[(process->backlog_begin + n) % process->backlog_capacity];
+        }
+        shared_free(process->backlog);
+
+        process->backlog = backlog;
+        process->backlog_begin = 0;
+        process->backlog_capacity = capacity;
+    }
+
+    process->backlog[(process->backlog_begin + process->n_backlog) % process->backlog_capacity] = time;
+    process->n_backlog++;
+    if (process->n_backlog > process->max_backlog) process->max_backlog = process->n_backlog;
+}
+
+void arrival_process_update(arrival_process_t* process, double now) {
+    while (process->next <= now) {
+        double time = process->next;
+        arrival_process_push(process, time);
+        arrival_process_schedule(process, time);
+    }
+}
+
+bool arrival_process_over(const arrival_process_t* process) {
+    return process->next == INFINITY;
+}
+
+double arrival_process_pop(arrival_process_t* process) {
+    passert_gt(size_t, "%zu", process->n_backlog, 0, "The backlog is empty");
+
+    double res = process->backlog[process->backlog_begin];
+    process->backlog_begin = (process->backlog_begin + 1) % process->backlog_capacity;
+    process->n_backlog--;
+
+    return res;
+}
+
+/// Adds the time spent since the last arrival or departure to the integral of the number of vehicles in the platform
+void arrival_process_account(arrival_process_t* process, double now) {
+    if (now <= process->in_platform_since) return;
+
+    process->in_platform_time += (process->arrivals - process->departures) * (now - process->in_platform_since);
+    process->in_platform_since = now;
+}
+
+void arrival_process_arrived(arrival_process_t* process, double now) {
+    arrival_process_account(process, now);
+    process->arrivals++;
+
+    size_t in_platform = process->arrivals - process->departures;
+    if (in_platform > process->max_in_platform) process->max_in_platform = in_platform;
+}
+
+void arrival_process_departed(arrival_process_t* process, double now, double latency) {
+    arrival_process_account(process, now);
+    process->departures++;
+    process->latency_sum += latency;
+    if (latency > process->max_latency) process->max_latency = latency;
+}
+
+void arrival_process_print(const arrival_process_t* process, const char* name, double elapsed) {
+    char description[64];
+    switch (process->type) {
+        case ARRIVAL_REPLACE:
+            snprintf(description, sizeof(description), "replace");
+            break;
+        case ARRIVAL_POISSON:
+            snprintf(description, sizeof(description), "poisson %.0f/s", process->rate);
+            break;
+        case ARRIVAL_ON_OFF:
+            snprintf(
+                description, sizeof(description),
+                "onoff %.0f/s %.0f/%.0f ms", process->rate, process->on * 1000.0, process->off * 1000.0
+            );
+            break;
+        case ARRIVAL_TRACE:
+            snprintf(description, sizeof(description), "trace of %zu", process->n_trace);
+            break;
+    }
+
+    // The vehicles still in the platform count until the end
+    double in_platform_time = process->in_platform_time;
+    if (elapsed > process->in_platform_since) {
+        in_platform_time += (process->arrivals - process->departures) * (elapsed - process->in_platform_since);
+    }
+
+    printf(
+        "%s (%s): %zu arrived (%.1f/s), %zu left (%.1f/s), in platform: %.1f avg, %zu max, backlog: %zu max (%zu left), "
+        "latency: %.3f ms avg, %.3f ms max\n",
+        name,
+        description,
+        process->arrivals,
+        elapsed > 0 ? process->arrivals / elapsed : 0.0,
+        process->departures,
+        elapsed > 0 ? process->departures / elapsed : 0.0,
+        elapsed > 0 ? in_platform_time / elapsed : 0.0,
+        process->max_in_platform,
+        process->max_backlog,
+        process->n_backlog,
+        process->departures > 0 ? process->latency_sum / process->departures * 1000.0 : 0.0,
+        process->max_latency * 1000.0
+    );
+}
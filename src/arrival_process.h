@@ -0,0 +1,107 @@
+/*! # arrival_process.h
+
+Arrival processes of the vehicles, which decide when the control tower lets a new truck, boat or train onto the platform.
+
+By default (`replace`), a vehicle arrives as soon as another one of the same kind leaves, so the platform is always
+fully loaded. The other processes schedule arrivals over time instead, at a target rate:
+- `poisson:<rate>`, arrivals separated by exponentially distributed delays, `<rate>` vehicles per second on average
+- `onoff:<rate>:<on>:<off>`, bursts of Poisson arrivals at `<rate>` during `<on>` ms, followed by `<off>` ms of silence
+- `trace:<file>`, arrivals at the times (in ms since the start, in increasing order, one per line) listed in `<file>`
+
+A vehicle that is due while there is no room for it on the platform (no free truck slot, or a full train pipeline)
+waits in the backlog of the process; its latency is measured from the time it was due, until it leaves the platform.
+
+Only the control tower may use the processes, so they aren't protected by a mutex.
+*/
+
+#ifndef ARRIVAL_PROCESS_H
+#define ARRIVAL_PROCESS_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/// Time during which the timed arrival processes schedule vehicles, if not specified with `--duration`
+#define ARRIVAL_DEFAULT_DURATION 1000
+
+enum arrival_process_type {
+    ARRIVAL_REPLACE,
+    ARRIVAL_POISSON,
+    ARRIVAL_ON_OFF,
+    ARRIVAL_TRACE,
+};
+
+struct arrival_process {
+    enum arrival_process_type type;
+
+    /// Target rate, in vehicles per second (during the on periods for `onoff`)
+    double rate;
+    /// Lengths of the on and off periods, in seconds
+    double on;
+    double off;
+
+    /// Arrival times of a trace, in seconds since the start
+    double* trace;
+    size_t n_trace;
+    size_t trace_index;
+
+    /// No arrival is scheduled after this time, in seconds since the start
+    double end;
+    unsigned int seed;
+
+    /// Time of the next arrival, in seconds since the start; INFINITY once the process is over (or if it isn't timed)
+    double next;
+
+    /// Times at which the vehicles waiting for room on the platform were due, oldest first
+    double* backlog;
+    size_t backlog_begin;
+    size_t n_backlog;
+    size_t backlog_capacity;
+
+    /// Statistics, see `arrival_process_print`
+    size_t arrivals;
+    size_t departures;
+    size_t max_backlog;
+    /// Integral of the number of vehicles in the platform over time, up to `in_platform_since`
+    double in_platform_time;
+    double in_platform_since;
+    size_t max_in_platform;
+    double latency_sum;
+    double max_latency;
+};
+typedef struct arrival_process arrival_process_t;
+
+/// Returns the time of a monotonic clock, in seconds
+double arrival_clock();
+
+/// Creates a `replace` process
+arrival_process_t new_arrival_process();
+
+/// Parses a process from its description (see above), returns false if it is invalid
+bool parse_arrival_process(const char* spec, arrival_process_t* res);
+
+void free_arrival_process(arrival_process_t* process);
+
+/// Returns true if the process schedules its arrivals over time, rather than replacing the vehicles that leave
+bool arrival_process_timed(const arrival_process_t* process);
+
+/// Schedules the first arrival after `now`; no arrival will be scheduled after `end` (both in seconds since the start)
+void arrival_process_start(arrival_process_t* process, double now, double end);
+
+/// Moves the arrivals that are due at `now` into the backlog
+void arrival_process_update(arrival_process_t* process, double now);
+
+/// Returns true if no more vehicle will be due
+bool arrival_process_over(const arrival_process_t* process);
+
+/// Removes the oldest vehicle from the backlog and returns the time it was due at
+double arrival_process_pop(arrival_process_t* process);
+
+/// Accounts for a vehicle that arrived on the platform, and for one that left it after `latency` seconds, at `now`
+/// (in seconds since the start)
+void arrival_process_arrived(arrival_process_t* process, double now);
+void arrival_process_departed(arrival_process_t* process, double now, double latency);
+
+/// Prints the statistics of the process, `elapsed` being the duration of the simulation in seconds
+void arrival_process_print(const arrival_process_t* process, const char* name, double elapsed);
+
+#endif // ARRIVAL_PROCESS_H
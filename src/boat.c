@@ -1,33 +1,15 @@
 #include "boat.h"
 #include "assert.h"
+#include "shared_memory.h"
+#include "container_index.h"
 #include "ulid.h"
 #include <pthread.h>
 
-boat_t new_boat(size_t destination, size_t n_cargo) {
-    struct ulid_generator* generator = get_generator();
-    boat_t res;
-
+void init_boat(boat_t* boat, size_t destination, size_t n_cargo) {
     passert_lt(size_t, "%zu", destination, N_DESTINATIONS);
-    res.destination = destination;
-
-    size_t n = 0;
-    for (; n < n_cargo && n < BOAT_CONTAINERS; n++) { // fill the n_cargo first elements with random destinations
-        size_t dest = rand() % N_DESTINATIONS;
-        if (dest == destination && N_DESTINATIONS > 1) {
-            // (X ~> U[0; n[) + (Y ~> U[0; n[) ~> U[0; n[ in the finite field (ℕ mod n)
-            dest = (dest + rand() % (N_DESTINATIONS - 1)) % N_DESTINATIONS;
-        }
-        res.containers[n] = new_container_holder(false, dest);
-    }
-    for (; n < BOAT_CONTAINERS; n++) { // fill the other elements with empty slots
-        res.containers[n] = new_container_holder(true, 0);
-    }
-
-    char encoded[27];
-    ulid_generate(generator, encoded);
-    ulid_decode(res.ulid, encoded);
-
-    return res;
+    boat->destination = destination;
+    boat_fill(boat, destination, n_cargo);
+    vehicle_new_ulid(boat->ulid);
 }
 
 void print_boat(const boat_t* boat, bool newline) {
@@ -42,42 +24,83 @@ void print_boat(const boat_t* boat, bool newline) {
         newline ? "\n" : ""
     );
 
-    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
-        if (newline) printf("  ");
-        print_container_holder(&boat->containers[n], false);
-        if (n < BOAT_CONTAINERS - 1) printf(", %s", newline ? "\n" : "");
-    }
+    boat_print_containers(boat, newline);
 
     printf("%s] }%s", newline ? "\n" : "", newline ? "\n" : "");
 }
 
-bool boat_is_full(boat_t* boat) {
-    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
-        if (boat->containers[n].is_empty) return false;
-    }
-    return true;
+boat_store_t new_boat_store() {
+    boat_store_t res;
+    res.chunks = NULL;
+    res.n_chunks = 0;
+    res.available = NULL;
+    res.n_available = 0;
+    res.in_use = 0;
+
+    return res;
 }
 
-size_t boat_loaded(boat_t* boat) {
-    size_t res = 0;
-    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
-        if (!boat->containers[n].is_empty) res += 1;
+void free_boat_store(boat_store_t* store) {
+    for (size_t n = 0; n < store->n_chunks; n++) {
+        shared_free(store->chunks[n]);
     }
+    shared_free(store->chunks);
+    shared_free(store->available);
+
+    store->chunks = NULL;
+    store->n_chunks = 0;
+    store->available = NULL;
+    store->n_available = 0;
+}
+
+boat_t* boat_store_alloc(boat_store_t* store) {
+    if (store->n_available == 0) {
+        boat_t* chunk = (boat_t*)shared_calloc(BOAT_STORE_CHUNK, sizeof(boat_t));
+        passert_neq(boat_t*, "%p", chunk, NULL, "Couldn't allocate %zu bytes of memory", BOAT_STORE_CHUNK * sizeof(boat_t));
+
+        store->n_chunks++;
+        store->chunks = (boat_t**)shared_realloc(store->chunks, store->n_chunks * sizeof(boat_t*));
+        passert_neq(boat_t**, "%p", store->chunks, NULL);
+        store->chunks[store->n_chunks - 1] = chunk;
+        container_index_register(CONTAINER_ON_BOAT, chunk, BOAT_STORE_CHUNK, sizeof(boat_t));
+
+        // Every boat of the store is either in use or available, so this is enough room for all of them
+        store->available = (boat_t**)shared_realloc(store->available, store->n_chunks * BOAT_STORE_CHUNK * sizeof(boat_t*));
+        passert_neq(boat_t**, "%p", store->available, NULL);
+        for (size_t n = 0; n < BOAT_STORE_CHUNK; n++) {
+            store->available[n] = &chunk[BOAT_STORE_CHUNK - n - 1];
+        }
+        store->n_available = BOAT_STORE_CHUNK;
+    }
+
+    store->n_available--;
+    boat_t* res = store->available[store->n_available];
+    store->in_use++;
+
     return res;
 }
 
-container_holder_t* boat_first_empty(boat_t* boat) {
-    for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
-        if (boat->containers[n].is_empty) return &boat->containers[n];
-    }
-    return NULL;
+boat_t* boat_store_acquire(boat_store_t* store, size_t destination, size_t n_cargo) {
+    boat_t* res = boat_store_alloc(store);
+    init_boat(res, destination, n_cargo);
+
+    return res;
+}
+
+void boat_store_release(boat_store_t* store, boat_t* boat) {
+    passert_neq(boat_t*, "%p", boat, NULL);
+    passert_gt(size_t, "%zu", store->in_use, 0, "Boat doesn't belong to this store!");
+
+    store->available[store->n_available] = boat;
+    store->n_available++;
+    store->in_use--;
 }
 
 boat_deque* new_boat_deque(size_t capacity) {
     passert_gt(size_t, "%zu", capacity, 0, "Capacity may not be zero, as to avoid undefined behavior.");
 
-    boat_deque* res = (boat_deque*)malloc(sizeof(boat_deque));
-    res->buffer = (boat_t*)malloc(capacity * sizeof(boat_t));
+    boat_deque* res = (boat_deque*)shared_malloc(sizeof(boat_deque));
+    res->buffer = (boat_t**)shared_malloc(capacity * sizeof(boat_t*));
     res->capacity = capacity;
     res->length = 0;
     res->begin = 0;
@@ -86,26 +109,26 @@ boat_deque* new_boat_deque(size_t capacity) {
 }
 
 void free_boat_deque(boat_deque* queue) {
-    free(queue->buffer);
-    free(queue);
+    shared_free(queue->buffer);
+    shared_free(queue);
 }
 
 void boat_deque_resize(boat_deque* queue, size_t capacity) {
-    boat_t* new_buffer = (boat_t*)malloc(capacity * sizeof(boat_t));
-    passert_neq(boat_t*, "%p", new_buffer, NULL, "Couldn't allocate %zu bytes of memory", capacity * sizeof(boat_t));
+    boat_t** new_buffer = (boat_t**)shared_malloc(capacity * sizeof(boat_t*));
+    passert_neq(boat_t**, "%p", new_buffer, NULL, "Couldn't allocate %zu bytes of memory", capacity * sizeof(boat_t*));
 
     // Compiler plz optimize away
     for (size_t n = 0; n < queue->length; n++) {
         new_buffer[n] = queue->buffer[(queue->begin + n) % queue->capacity];
     }
 
-    free(queue->buffer);
+    shared_free(queue->buffer);
     queue->buffer = new_buffer;
     queue->capacity = capacity;
     queue->begin = 0;
 }
 
-bool boat_deque_pop_front(boat_deque* queue, boat_t* dest) {
+bool boat_deque_pop_front(boat_deque* queue, boat_t** dest) {
     if (queue->length == 0) return false;
     *dest = queue->buffer[queue->begin];
     queue->begin = (queue->begin + 1) % queue->capacity;
@@ -115,10 +138,10 @@ bool boat_deque_pop_front(boat_deque* queue, boat_t* dest) {
 
 boat_t* boat_deque_get(boat_deque* queue, size_t n) {
     if (queue->length == 0) return NULL;
-    return &queue->buffer[(queue->begin + n) % queue->capacity];
+    return queue->buffer[(queue->begin + n) % queue->capacity];
 }
 
-void boat_deque_push_back(boat_deque* queue, boat_t boat) {
+void boat_deque_push_back(boat_deque* queue, boat_t* boat) {
     if (queue->length == queue->capacity) {
         boat_deque_resize(queue, queue->capacity * 2);
     }
@@ -133,7 +156,7 @@ void boat_deque_print(boat_deque* queue, bool short_version) {
             printf("  (");
             boat_t* boat = boat_deque_get(queue, n);
             for (size_t o = 0; o < BOAT_CONTAINERS; o++) {
-                if (boat->containers[o].is_empty) {
+                if (container_holder_is_empty(&boat->containers[o])) {
                     printf("-");
                 } else if (boat->destination != boat->containers[o].container.destination) {
                     printf("x");
@@ -162,10 +185,12 @@ void boat_deque_print(boat_deque* queue, bool short_version) {
 boat_lane_t new_boat_lane() {
     boat_lane_t res;
     res.queue = new_boat_deque(1);
-    res.has_current_boat = false;
+    res.current_boat = NULL;
+    atomic_init(&res.lock_waits, 0);
 
     pthread_mutexattr_t attributes;
     passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_setpshared(&attributes, 1), 0);
     passert_eq(int, "%d", pthread_mutex_init(&res.mutex, &attributes), 0);
     passert_eq(int, "%d", pthread_mutexattr_destroy(&attributes), 0);
 
@@ -180,15 +205,15 @@ void free_boat_lane(boat_lane_t* boat_lane) {
 void boat_lane_print(boat_lane_t* boat_lane, bool short_version) {
     printf("BoatLane { queue = ");
     boat_deque_print(boat_lane->queue, short_version);
-    if (!boat_lane->has_current_boat) {
+    if (boat_lane->current_boat == NULL) {
         printf(", current_boat = None }\n");
     } else {
         printf(", current_boat = ");
         if (short_version) {
             printf("(");
-            boat_t* boat = &boat_lane->current_boat;
+            boat_t* boat = boat_lane->current_boat;
             for (size_t o = 0; o < BOAT_CONTAINERS; o++) {
-                if (boat->containers[o].is_empty) {
+                if (container_holder_is_empty(&boat->containers[o])) {
                     printf("-");
                 } else if (boat->destination != boat->containers[o].container.destination) {
                     printf("x");
@@ -198,13 +223,16 @@ void boat_lane_print(boat_lane_t* boat_lane, bool short_version) {
             }
             printf(")");
         } else {
-            print_boat(&boat_lane->current_boat, false);
+            print_boat(boat_lane->current_boat, false);
         }
         printf(" }\n");
     }
 }
 
 void boat_lane_lock(boat_lane_t* boat_lane) {
+    if (pthread_mutex_trylock(&boat_lane->mutex) == 0) return;
+
+    atomic_fetch_add_explicit(&boat_lane->lock_waits, 1, memory_order_relaxed);
     passert_eq(int, "%d", pthread_mutex_lock(&boat_lane->mutex), 0);
 }
 
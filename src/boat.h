@@ -8,8 +8,11 @@ Contains the `boat_t` struct, alongside a vecdeque of boats and the mutex system
 #define BOAT_H
 
 #include "container.h"
+#include "vehicle.h"
+#include "cache_line.h"
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #define BOAT_CONTAINERS 5
 
@@ -20,23 +23,57 @@ struct boat {
     size_t destination;
     // The unique ID of the boat, see container.h for more information
     unsigned char ulid[16];
+    // When the boat arrived on the platform, in seconds on the control tower's clock
+    double arrived;
 };
 typedef struct boat boat_t;
 
-/// Creates a new boat, giving it a destination and n_cargo containers with random destinations.
+/// Initializes `boat` in place, giving it a destination and n_cargo containers with random destinations.
 /// Their destinations will be different than the boat's destination, if possible
-boat_t new_boat(size_t destination, size_t n_cargo);
+void init_boat(boat_t* boat, size_t destination, size_t n_cargo);
 
 /// Prints a boat, used for debugging.
 void print_boat(const boat_t* boat, bool newline);
 
-bool boat_is_full(boat_t* boat);
-size_t boat_loaded(boat_t* boat);
-container_holder_t* boat_first_empty(boat_t* boat);
+VEHICLE(boat, boat_t, BOAT_CONTAINERS)
 
-/// Boat double-ended queue (DEQue)
+/// Number of boats allocated at once by a boat store
+#define BOAT_STORE_CHUNK 32
+
+/// Stable storage for the boats: boats never move once allocated, so their ownership can be handed
+/// from one agent to another by passing a pointer around.
+/// Boats are allocated in chunks, which are only freed alongside the store.
+/// Only the control tower may acquire and release boats, so the store isn't protected by a mutex
+struct boat_store {
+    boat_t** chunks;
+    size_t n_chunks;
+
+    /// Stack of the boats that can be handed out
+    boat_t** available;
+    size_t n_available;
+
+    size_t in_use;
+};
+typedef struct boat_store boat_store_t;
+
+/// Creates a new, empty boat store
+boat_store_t new_boat_store();
+
+/// Should be called once for every boat_store_t instance, after none of its boats are in use anymore
+void free_boat_store(boat_store_t* store);
+
+/// Takes a boat from the store (allocating a new chunk if needed), without initializing it
+boat_t* boat_store_alloc(boat_store_t* store);
+
+/// Takes a boat from the store and initializes it, see `init_boat`
+boat_t* boat_store_acquire(boat_store_t* store, size_t destination, size_t n_cargo);
+
+/// Gives a boat back to the store, once it left the platform
+void boat_store_release(boat_store_t* store, boat_t* boat);
+
+/// Boat double-ended queue (DEQue), holding references to boats owned by a boat_store_t
 struct boat_deque {
-    boat_t* buffer;
+    boat_t** buffer;
     size_t capacity;
     size_t begin;
     size_t length;
@@ -54,25 +91,29 @@ void free_boat_deque(boat_deque* queue);
 void boat_deque_resize(boat_deque* queue, size_t capacity);
 
 /// Pops a boat at the head of the queue; if the queue is empty, returns false.
-bool boat_deque_pop_front(boat_deque* queue, boat_t* dest);
+bool boat_deque_pop_front(boat_deque* queue, boat_t** dest);
 
-/// Returns a reference to the n-th element from the head of the queue.
-/// This reference is only valid until queue is manipulated.
+/// Returns the n-th boat from the head of the queue.
+/// The boat is only owned by the queue's owner until the queue is manipulated.
 /// If the queue is empty, returns NULL.
 boat_t* boat_deque_get(boat_deque* queue, size_t n);
 
 /// Pushes a boat onto the queue. If the queue is full, reallocates a new buffer
-void boat_deque_push_back(boat_deque* queue, boat_t boat);
+void boat_deque_push_back(boat_deque* queue, boat_t* boat);
 
 /// Prints a boat queue, used for debugging
 void boat_deque_print(boat_deque* queue, bool short_version);
 
 struct boat_lane {
     boat_deque* queue;
-    boat_t current_boat;
-    bool has_current_boat;
-
     pthread_mutex_t mutex;
+
+    /// Number of times that locking the lane had to wait for another agent
+    atomic_size_t lock_waits;
+
+    /// The boat stationned at the crane, or NULL if there are none.
+    /// Only accessed by the crane, so it is kept away from the mutex-protected queue
+    CACHE_ALIGNED boat_t* current_boat;
 };
 typedef struct boat_lane boat_lane_t;
 
@@ -0,0 +1,22 @@
+/*! # cache_line.h
+
+Helpers to lay out the structures shared between agents, so that fields written by different agents
+don't end up on the same cache line (false sharing).
+
+Define `NO_CACHE_ALIGN` (`make DEFINES=NO_CACHE_ALIGN`) to disable the alignment; `results/measure-moves.sh`
+uses it to measure the effect of the layout.
+*/
+
+#ifndef CACHE_LINE_H
+#define CACHE_LINE_H
+
+#define CACHE_LINE_SIZE 64
+
+#ifdef NO_CACHE_ALIGN
+    #define CACHE_ALIGNED
+#else
+    /// Starts a new cache line at the annotated field
+    #define CACHE_ALIGNED _Alignas(CACHE_LINE_SIZE)
+#endif
+
+#endif // CACHE_LINE_H
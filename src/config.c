@@ -0,0 +1,308 @@
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include "assert.h"
+#include "stats.h"
+#include "container.h"
+#include "yard.h"
+
+config_t default_config() {
+    config_t res;
+
+    res.cpu_alpha = -1;
+    res.cpu_beta = -1;
+    res.cpu_tower = -1;
+
+    res.stats_name = STATS_DEFAULT_NAME;
+
+    res.save_snapshot = NULL;
+    res.load_snapshot = NULL;
+
+    res.record_arrivals = NULL;
+    res.replay_arrivals = NULL;
+
+    res.trucks = new_arrival_process();
+    res.boats = new_arrival_process();
+    res.trains = new_arrival_process();
+    res.duration = ARRIVAL_DEFAULT_DURATION;
+
+    res.n_terminals = 1;
+    res.transfer = false;
+
+    res.processes = false;
+
+    res.dispatchers = false;
+
+    res.queue_capacity = MESSAGE_QUEUE_DEFAULT_CAPACITY;
+    res.backpressure = BACKPRESSURE_BLOCK;
+    res.fifo_queues = false;
+
+    res.ledger = NULL;
+
+    res.routing = ROUTING_FIXED;
+
+    res.yard_height = 0;
+
+    res.timing = false;
+
+    return res;
+}
+
+/// Parses a CPU index, exits if it isn't a valid index
+int parse_cpu(const char* program, const char* option, const char* arg) {
+    char* end;
+    long cpu = strtol(arg, &end, 10);
+
+    if (*arg == '\0' || *end != '\0' || cpu < 0) {
+        fprintf(stderr, FMT_ERROR("ERROR") ": invalid CPU index for --%s: '%s'\n", option, arg);
+        print_usage(program);
+        exit(1);
+    }
+
+    return (int)cpu;
+}
+
+/// Parses an arrival process, exits if it isn't valid
+arrival_process_t parse_process(const char* program, const char* option, const char* arg) {
+    arrival_process_t res;
+
+    if (!parse_arrival_process(arg, &res)) {
+        fprintf(stderr, FMT_ERROR("ERROR") ": invalid arrival process for --%s: '%s'\n", option, arg);
+        print_usage(program);
+        exit(1);
+    }
+
+    return res;
+}
+
+/// Options that only have a long form
+enum long_option {
+    OPTION_TRUCKS = 256,
+    OPTION_BOATS,
+    OPTION_TRAINS,
+    OPTION_DURATION,
+    OPTION_TRANSFER,
+    OPTION_LEDGER,
+    OPTION_ROUTING,
+    OPTION_DISPATCHERS,
+    OPTION_QUEUE_CAPACITY,
+    OPTION_BACKPRESSURE,
+    OPTION_FIFO_QUEUES,
+    OPTION_YARD,
+    OPTION_TIMING,
+};
+
+config_t parse_config(int argc, char* argv[]) {
+    config_t res = default_config();
+
+    static struct option options[] = {
+        {"cpu-alpha", required_argument, NULL, 'a'},
+        {"cpu-beta", required_argument, NULL, 'b'},
+        {"cpu-tower", required_argument, NULL, 't'},
+        {"stats", required_argument, NULL, 's'},
+        {"save-snapshot", required_argument, NULL, 'S'},
+        {"load-snapshot", required_argument, NULL, 'L'},
+        {"record-arrivals", required_argument, NULL, 'r'},
+        {"replay-arrivals", required_argument, NULL, 'R'},
+        {"trucks", required_argument, NULL, OPTION_TRUCKS},
+        {"boats", required_argument, NULL, OPTION_BOATS},
+        {"trains", required_argument, NULL, OPTION_TRAINS},
+        {"duration", required_argument, NULL, OPTION_DURATION},
+        {"terminals", required_argument, NULL, 'k'},
+        {"transfer", no_argument, NULL, OPTION_TRANSFER},
+        {"ledger", required_argument, NULL, OPTION_LEDGER},
+        {"routing", required_argument, NULL, OPTION_ROUTING},
+        {"yard", required_argument, NULL, OPTION_YARD},
+        {"timing", no_argument, NULL, OPTION_TIMING},
+        {"processes", no_argument, NULL, 'p'},
+        {"dispatchers", no_argument, NULL, OPTION_DISPATCHERS},
+        {"queue-capacity", required_argument, NULL, OPTION_QUEUE_CAPACITY},
+        {"backpressure", required_argument, NULL, OPTION_BACKPRESSURE},
+        {"fifo-queues", no_argument, NULL, OPTION_FIFO_QUEUES},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "a:b:t:s:S:L:r:R:k:ph", options, NULL)) != -1) {
+        switch (option) {
+            case 'a':
+                res.cpu_alpha = parse_cpu(argv[0], "cpu-alpha", optarg);
+                break;
+            case 'b':
+                res.cpu_beta = parse_cpu(argv[0], "cpu-beta", optarg);
+                break;
+            case 't':
+                res.cpu_tower = parse_cpu(argv[0], "cpu-tower", optarg);
+                break;
+            case 's':
+                res.stats_name = optarg;
+                break;
+            case 'S':
+                res.save_snapshot = optarg;
+                break;
+            case 'L':
+                res.load_snapshot = optarg;
+                break;
+            case 'r':
+                res.record_arrivals = optarg;
+                break;
+            case 'R':
+                res.replay_arrivals = optarg;
+                break;
+            case OPTION_TRUCKS:
+                res.trucks = parse_process(argv[0], "trucks", optarg);
+                break;
+            case OPTION_BOATS:
+                res.boats = parse_process(argv[0], "boats", optarg);
+                break;
+            case OPTION_TRAINS:
+                res.trains = parse_process(argv[0], "trains", optarg);
+                break;
+            case OPTION_DURATION: {
+                char* end;
+                res.duration = strtod(optarg, &end);
+                if (*optarg == '\0' || *end != '\0' || !(res.duration >= 0)) {
+                    fprintf(stderr, FMT_ERROR("ERROR") ": invalid duration: '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            }
+            case 'k': {
+                char* end;
+                long n_terminals = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n_terminals < 1) {
+                    fprintf(stderr, FMT_ERROR("ERROR") ": invalid number of terminals: '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    exit(1);
+                }
+                res.n_terminals = n_terminals;
+                break;
+            }
+            case OPTION_TRANSFER:
+                res.transfer = true;
+                break;
+            case 'p':
+                res.processes = true;
+                break;
+            case OPTION_DISPATCHERS:
+                res.dispatchers = true;
+                break;
+            case OPTION_QUEUE_CAPACITY: {
+                char* end;
+                long capacity = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || capacity < 0) {
+                    fprintf(stderr, FMT_ERROR("ERROR") ": invalid queue capacity: '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    exit(1);
+                }
+                res.queue_capacity = capacity;
+                break;
+            }
+            case OPTION_BACKPRESSURE:
+                if (!parse_backpressure(optarg, &res.backpressure)) {
+                    fprintf(stderr, FMT_ERROR("ERROR") ": invalid backpressure policy: '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case OPTION_FIFO_QUEUES:
+                res.fifo_queues = true;
+                break;
+            case OPTION_LEDGER:
+                res.ledger = optarg;
+                break;
+            case OPTION_ROUTING:
+                if (!parse_routing_policy(optarg, &res.routing)) {
+                    fprintf(stderr, FMT_ERROR("ERROR") ": invalid routing policy: '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case OPTION_YARD: {
+                char* end;
+                long height = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || height < 0 || height > YARD_MAX_HEIGHT) {
+                    fprintf(stderr, FMT_ERROR("ERROR") ": invalid yard height (at most %d): '%s'\n", YARD_MAX_HEIGHT, optarg);
+                    print_usage(argv[0]);
+                    exit(1);
+                }
+                res.yard_height = height;
+                break;
+            }
+            case OPTION_TIMING:
+                res.timing = true;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                print_usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (res.transfer && res.n_terminals > N_DESTINATIONS) {
+        fprintf(stderr, FMT_ERROR("ERROR") ": --transfer needs at most %d terminals, so that each serves a destination\n", N_DESTINATIONS);
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+    if (res.record_arrivals != NULL && res.replay_arrivals != NULL) {
+        fprintf(stderr, FMT_ERROR("ERROR") ": --record-arrivals and --replay-arrivals are mutually exclusive\n");
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+    return res;
+}
+
+void print_usage(const char* name) {
+    printf("Usage: %s [OPTIONS]\n", name);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -a, --cpu-alpha <cpu>         Pins crane α to <cpu> and allocates its lanes on that CPU's NUMA node\n");
+    printf("  -b, --cpu-beta <cpu>          Pins crane β to <cpu> and allocates its lanes on that CPU's NUMA node\n");
+    printf("  -t, --cpu-tower <cpu>         Pins the control tower to <cpu> and allocates its queue on that CPU's NUMA node\n");
+    printf("  -s, --stats <name>            Publishes live statistics in the shared memory segment <name> (default: %s)\n", STATS_DEFAULT_NAME);
+    printf("  -S, --save-snapshot <file>    Saves the initial state of the platform to <file>\n");
+    printf("  -L, --load-snapshot <file>    Restores the initial state of the platform from <file>, instead of generating it\n");
+    printf("  -r, --record-arrivals <file>  Records the vehicles arriving on the platform to <file>\n");
+    printf("  -R, --replay-arrivals <file>  Replays the vehicles recorded in <file>, instead of generating them\n");
+    printf("      --trucks <process>        When the trucks arrive (default: replace)\n");
+    printf("      --boats <process>         When the boats arrive (default: replace)\n");
+    printf("      --trains <process>        When the trains arrive (default: replace)\n");
+    printf("      --duration <ms>           For how long vehicles keep arriving, with timed processes (default: %d)\n", ARRIVAL_DEFAULT_DURATION);
+    printf("  -k, --terminals <k>           Runs <k> independent terminals side by side (default: 1)\n");
+    printf("      --transfer                Splits the destinations between the terminals, which send each other the containers\n");
+    printf("  -p, --processes               Runs each crane and control tower as a separate process, sharing the platform in shared memory\n");
+    printf("      --dispatchers             Runs one thread per lane (trucks, boats, trains) in the control tower, each with its own queue\n");
+    printf("      --queue-capacity <n>      How many messages each queue of the control tower holds, 0 for no limit (default: %d)\n", MESSAGE_QUEUE_DEFAULT_CAPACITY);
+    printf("      --backpressure <policy>   What the cranes do when a queue of the control tower is full (default: block)\n");
+    printf("      --fifo-queues             Handles the messages in the order they were sent, instead of control and vehicle messages first\n");
+    printf("      --ledger <file>           Records the moves of the containers and saves them to <file>, see sy40_ledger\n");
+    printf("      --routing <policy>        Decides onto which vehicle the cranes unload each container (default: fixed)\n");
+    printf("      --yard <height>           Stages the containers that no vehicle can take next to the cranes, in stacks of <height> (default: 0, no yard)\n");
+    printf("      --timing                  Simulates how long the moves of real cranes take, and reports the makespan\n");
+    printf("  -h, --help                    Prints this message\n");
+    printf("\n");
+    printf("Arrival processes:\n");
+    printf("  replace                       A new vehicle arrives whenever one leaves\n");
+    printf("  poisson:<rate>                Poisson arrivals, <rate> vehicles per second on average\n");
+    printf("  onoff:<rate>:<on>:<off>       Poisson arrivals at <rate> during <on> ms, then none during <off> ms\n");
+    printf("  trace:<file>                  Arrivals at the times listed in <file>, in ms (one per line)\n");
+    printf("\n");
+    printf("Routing policies:\n");
+    printf("  fixed                         The boat at bay, then the wagons, then the trucks\n");
+    printf("  fullest                       The vehicle with the largest share of its slots loaded\n");
+    printf("  departure                     The vehicle with the fewest free slots\n");
+    printf("  boat-dwell                    The boat at bay, then the vehicle that arrived first\n");
+    printf("  random                        Any vehicle that can take the container\n");
+    printf("\n");
+    printf("Backpressure policies:\n");
+    printf("  block                         The crane sleeps until the control tower makes room\n");
+    printf("  spin                          The crane retries, yielding its CPU in between\n");
+    printf("  shed                          CRANE_STUCK messages are dropped, the other ones block\n");
+}
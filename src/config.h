@@ -0,0 +1,80 @@
+/*! # config.h
+
+Runtime configuration of the platform, read from the command line arguments.
+Run `./build/sy40_project --help` for the list of options.
+*/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+#include "arrival_process.h"
+#include "routing.h"
+#include "message.h"
+
+struct config {
+    /// The CPU that each agent is pinned to, or -1 to let the kernel schedule it freely
+    int cpu_alpha;
+    int cpu_beta;
+    int cpu_tower;
+
+    /// Name of the shared memory segment in which the statistics are published
+    const char* stats_name;
+
+    /// If not NULL, the state of the platform is saved to/restored from these files before the agents start
+    const char* save_snapshot;
+    const char* load_snapshot;
+
+    /// If not NULL, the arrivals of vehicles are recorded to/replayed from these files, see `arrival_log.h`
+    const char* record_arrivals;
+    const char* replay_arrivals;
+
+    /// When the trucks, boats and trains arrive, see `arrival_process.h`
+    arrival_process_t trucks;
+    arrival_process_t boats;
+    arrival_process_t trains;
+    /// For how long the timed processes schedule arrivals, in milliseconds
+    double duration;
+
+    /// The number of terminals running side by side, and whether they split the destinations between them (see `terminal.h`)
+    size_t n_terminals;
+    bool transfer;
+
+    /// Whether the agents run as separate processes sharing a memory region, rather than threads (see `shared_memory.h`)
+    bool processes;
+
+    /// Whether the control tower runs one dispatcher per lane, rather than a single one (see `control_tower.h`)
+    bool dispatchers;
+
+    /// The capacity of the queues of the control tower (0 for unbounded queues), and what the cranes do when
+    /// one of them is full, see `message.h`
+    size_t queue_capacity;
+    enum backpressure backpressure;
+
+    /// Whether the messages are handled in the order they were sent, rather than by priority (see `message.h`)
+    bool fifo_queues;
+
+    /// If not NULL, the moves of the containers are recorded and saved to this file once the agents stopped, see `ledger.h`
+    const char* ledger;
+
+    /// Decides onto which vehicle the cranes unload each container, see `routing.h`
+    enum routing_policy routing;
+
+    /// How many containers each stack of the yards of the cranes holds, 0 for no yard (see `yard.h`)
+    size_t yard_height;
+
+    /// Whether the cranes keep a simulated clock of their moves, and report the makespan of each terminal (see `timing.h`)
+    bool timing;
+};
+typedef struct config config_t;
+
+/// Returns the default configuration
+config_t default_config();
+
+/// Parses the command line arguments into a config_t; prints the usage and exits on invalid arguments
+config_t parse_config(int argc, char* argv[]);
+
+/// Prints the usage of the program
+void print_usage(const char* name);
+
+#endif // CONFIG_H
@@ -1,7 +1,137 @@
 #include "container.h"
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "assert.h"
 #include "ulid.h"
+#include "container_index.h"
+#include "shared_memory.h"
+
+/// Enough blocks for every id that fits in a container
+#define CONTAINER_ULID_BLOCKS (((size_t)UINT32_MAX + 1) / CONTAINER_ULID_BLOCK)
+
+struct container_ulid_block {
+    unsigned char ulids[CONTAINER_ULID_BLOCK][16];
+};
+
+/// Marks the end of the list of free ids
+#define CONTAINER_ID_NONE UINT32_MAX
+
+/// Ids are given back by the containers leaving the platform (see `free_containers`) and handed out again, so the table
+/// only grows with the number of containers on the platform at once. Blocks are only ever added, so that the ULID of
+/// a container can be read without taking the mutex
+struct container_ulids {
+    pthread_mutex_t mutex;
+    /// Every id below it was handed out at least once
+    uint32_t next_id;
+    /// The last id given back, whose slot holds the id given back before it, and so on
+    uint32_t free_id;
+
+    _Atomic(struct container_ulid_block*) blocks[CONTAINER_ULID_BLOCKS];
+};
+
+/// Inherited by the agents' processes, like the shared region it lives in
+static struct container_ulids* container_ulids = NULL;
+
+void container_ulids_init() {
+    passert(container_ulids == NULL, "The table of ULIDs already exists");
+
+    container_ulids = (struct container_ulids*)shared_malloc(sizeof(struct container_ulids));
+    passert_neq(struct container_ulids*, "%p", container_ulids, NULL);
+
+    pthread_mutexattr_t attributes;
+    passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_setpshared(&attributes, 1), 0);
+    passert_eq(int, "%d", pthread_mutex_init(&container_ulids->mutex, &attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_destroy(&attributes), 0);
+
+    container_ulids->next_id = 0;
+    container_ulids->free_id = CONTAINER_ID_NONE;
+    for (size_t n = 0; n < CONTAINER_ULID_BLOCKS; n++) {
+        atomic_init(&container_ulids->blocks[n], NULL);
+    }
+}
+
+void container_ulids_free() {
+    if (container_ulids == NULL) return;
+
+    for (size_t n = 0; n < CONTAINER_ULID_BLOCKS; n++) {
+        struct container_ulid_block* block = atomic_load(&container_ulids->blocks[n]);
+        if (block != NULL) shared_free(block);
+    }
+    pthread_mutex_destroy(&container_ulids->mutex);
+    shared_free(container_ulids);
+    container_ulids = NULL;
+}
+
+/// Returns the slot of the ULID of `id`, which must have been handed out
+unsigned char* container_ulids_slot(uint32_t id) {
+    struct container_ulid_block* block = atomic_load(&container_ulids->blocks[id / CONTAINER_ULID_BLOCK]);
+    return block->ulids[id % CONTAINER_ULID_BLOCK];
+}
+
+/// Reserves an id, reusing one that was given back if there is any, and returns the slot of its ULID
+unsigned char* container_ulids_push(uint32_t* id) {
+    passert_neq(struct container_ulids*, "%p", container_ulids, NULL, "The table of ULIDs wasn't created");
+    passert_eq(int, "%d", pthread_mutex_lock(&container_ulids->mutex), 0);
+
+    uint32_t res = container_ulids->free_id;
+    if (res != CONTAINER_ID_NONE) {
+        memcpy(&container_ulids->free_id, container_ulids_slot(res), sizeof(uint32_t));
+    } else {
+        res = container_ulids->next_id;
+        passert_neq(uint32_t, "%" PRIu32, res, CONTAINER_ID_NONE, "Too many containers are on the platform");
+        container_ulids->next_id++;
+
+        _Atomic(struct container_ulid_block*)* slot = &container_ulids->blocks[res / CONTAINER_ULID_BLOCK];
+        if (atomic_load(slot) == NULL) {
+            struct container_ulid_block* block = (struct container_ulid_block*)shared_malloc(sizeof(struct container_ulid_block));
+            passert_neq(struct container_ulid_block*, "%p", block, NULL);
+            atomic_store(slot, block);
+        }
+    }
+
+    passert_eq(int, "%d", pthread_mutex_unlock(&container_ulids->mutex), 0);
+
+    *id = res;
+    return container_ulids_slot(res);
+}
+
+void free_containers(container_holder_t* holders, size_t n) {
+    passert_eq(int, "%d", pthread_mutex_lock(&container_ulids->mutex), 0);
+
+    for (size_t h = 0; h < n; h++) {
+        if (container_holder_is_empty(&holders[h])) continue;
+
+        uint32_t id = holders[h].container.id;
+        memcpy(container_ulids_slot(id), &container_ulids->free_id, sizeof(uint32_t));
+        container_ulids->free_id = id;
+        holders[h].container.destination = CONTAINER_NONE;
+    }
+
+    passert_eq(int, "%d", pthread_mutex_unlock(&container_ulids->mutex), 0);
+}
+
+void container_ulids_print() {
+    passert_eq(int, "%d", pthread_mutex_lock(&container_ulids->mutex), 0);
+
+    size_t free = 0;
+    for (uint32_t id = container_ulids->free_id; id != CONTAINER_ID_NONE; free++) {
+        memcpy(&id, container_ulids_slot(id), sizeof(uint32_t));
+    }
+    printf(
+        "ContainerUlids { ids = %" PRIu32 ", free = %zu, blocks = %zu }\n",
+        container_ulids->next_id,
+        free,
+        ((size_t)container_ulids->next_id + CONTAINER_ULID_BLOCK - 1) / CONTAINER_ULID_BLOCK
+    );
+
+    passert_eq(int, "%d", pthread_mutex_unlock(&container_ulids->mutex), 0);
+}
+
+const unsigned char* container_ulid(const container_t* container) {
+    return container_ulids_slot(container->id);
+}
 
 /// Creates a new container; a thread-specific ulid_generator is implicitely created
 container_t new_container(size_t destination) {
@@ -12,7 +142,16 @@ container_t new_container(size_t destination) {
     res.destination = destination;
     char encoded[27];
     ulid_generate(generator, encoded);
-    ulid_decode(res.ulid, encoded);
+    ulid_decode(container_ulids_push(&res.id), encoded);
+
+    return res;
+}
+
+container_t restore_container(size_t destination, const unsigned char ulid[16]) {
+    passert_lt(size_t, "%zu", destination, N_DESTINATIONS);
+    container_t res;
+    res.destination = destination;
+    memcpy(container_ulids_push(&res.id), ulid, 16);
 
     return res;
 }
@@ -20,9 +159,9 @@ container_t new_container(size_t destination) {
 /// Used for debugging
 void print_container(const container_t* container, bool newline) {
     char encoded[27];
-    ulid_encode(encoded, container->ulid);
+    ulid_encode(encoded, container_ulid(container));
     printf(
-        "Container { destination = %s (%zu), ulid = %s }%s",
+        "Container { destination = %s (%" PRIu8 "), ulid = %s }%s",
         DESTINATION_NAMES[container->destination],
         container->destination,
         encoded,
@@ -30,15 +169,13 @@ void print_container(const container_t* container, bool newline) {
     );
 }
 
-/// Creates a new container holder. If `is_empty` is true, all of the fields of the container hold are set to zero.
+/// Creates a new container holder. If `is_empty` is true, the holder is marked as such and `destination` is ignored.
 container_holder_t new_container_holder(bool is_empty, size_t destination) {
     container_holder_t res;
 
-    res.is_empty = is_empty;
-
     if (is_empty) {
-        res.container.destination = 0;
-        memset(&res.container.ulid, 0, 16);
+        res.container.destination = CONTAINER_NONE;
+        res.container.id = 0;
     } else {
         res.container = new_container(destination);
     }
@@ -48,7 +185,7 @@ container_holder_t new_container_holder(bool is_empty, size_t destination) {
 
 /// Used for debugging
 void print_container_holder(const container_holder_t* holder, bool newline) {
-    if (holder->is_empty) {
+    if (container_holder_is_empty(holder)) {
         printf("(Empty)%s", newline ? "\n" : "");
     } else {
         printf("(");
@@ -58,10 +195,11 @@ void print_container_holder(const container_holder_t* holder, bool newline) {
 }
 
 void transfer_container(container_holder_t* from, container_holder_t* to) {
-    passert(!from->is_empty, "Expected source container holder to have a container.");
-    passert(to->is_empty, "Expected target container holder to be empty.");
+    passert(!container_holder_is_empty(from), "Expected source container holder to have a container.");
+    passert(container_holder_is_empty(to), "Expected target container holder to be empty.");
 
     to->container = from->container;
-    from->is_empty = true;
-    to->is_empty = false;
+    from->container.destination = CONTAINER_NONE;
+
+    container_index_place(to);
 }
@@ -1,6 +1,12 @@
 /*! # container.h
 
 Defines the `container_t` struct and its methods.
+
+Containers are kept small, since vehicles are scanned slot by slot: the destination fits in a byte, an empty holder
+is marked with the `CONTAINER_NONE` destination, and the ULID of each container lives out-of-line in a table shared
+by all the agents, where the container only keeps its index. A holder is thus 8 bytes instead of 32.
+Indices are given back once containers leave the platform, so the table is as large as the most containers that were
+on the platform at once, rather than all the containers ever created.
 */
 
 #ifndef CONTAINER_H
@@ -9,6 +15,7 @@ Defines the `container_t` struct and its methods.
 #include <stdlib.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define N_DESTINATIONS 5
 static const char* DESTINATION_NAMES[N_DESTINATIONS] = {
@@ -19,33 +26,69 @@ static const char* DESTINATION_NAMES[N_DESTINATIONS] = {
     "Singapour"
 };
 
+/// The destination of the container of an empty holder
+#define CONTAINER_NONE UINT8_MAX
+
+_Static_assert(N_DESTINATIONS < CONTAINER_NONE, "Destinations don't fit in a container");
+
 struct container {
-    /// The index of the destination, guaranteed to be a valid index of DESINATION_NAMES
-    size_t destination;
-    /// A unique identifier for the container, see ulid.h for more information
-    unsigned char ulid[16];
+    /// The index of the destination, guaranteed to be a valid index of DESINATION_NAMES (unless the holder is empty)
+    uint8_t destination;
+    /// The index of the container's ULID in the table of ULIDs, see `container_ulid`
+    uint32_t id;
 };
 typedef struct container container_t;
 
+/// The number of ULIDs in each block of the table of ULIDs, which are allocated as containers get created
+#define CONTAINER_ULID_BLOCK ((size_t)1 << 16)
+
+/// Creates the table of ULIDs; must be called before any container is created.
+/// In multi-process mode, must be called after `shared_memory_init` and before the agents are started
+void container_ulids_init();
+
+/// Frees the table of ULIDs, once no container is used anymore
+void container_ulids_free();
+
+/// Prints how many ids the table of ULIDs handed out, and how many of them are free to be reused
+void container_ulids_print();
+
 /// Creates a new container; a thread-specific ulid_generator is implicitely created
 container_t new_container(size_t destination);
 
+/// Creates a container with a known ULID, used to replay the arrival log (see `arrival_log.h`)
+container_t restore_container(size_t destination, const unsigned char ulid[16]);
+
+/// Returns the unique identifier of the container (16 bytes), see ulid.h for more information.
+/// Only valid until the container is freed
+const unsigned char* container_ulid(const container_t* container);
+
 /// Used for debugging
 void print_container(const container_t* container, bool newline);
 
 /// Used by vehicles
 struct container_holder {
+    /// Its destination is `CONTAINER_NONE` if the holder is empty
     container_t container;
-    bool is_empty;
 };
 typedef struct container_holder container_holder_t;
 
-/// Creates a new container holder. If `is_empty` is true, all of the fields of the container hold are set to zero.
+_Static_assert(sizeof(container_holder_t) == 8, "Container holders should stay compact");
+
+static inline bool container_holder_is_empty(const container_holder_t* holder) {
+    return holder->container.destination == CONTAINER_NONE;
+}
+
+/// Creates a new container holder. If `is_empty` is true, the holder is marked as such and `destination` is ignored.
 container_holder_t new_container_holder(bool is_empty, size_t destination);
 
 /// Used for debugging
 void print_container_holder(const container_holder_t* holder, bool newline);
 
+/// Moves the container of `from` into `to`, and records its new place in the container index (see `container_index.h`)
 void transfer_container(container_holder_t* from, container_holder_t* to);
 
+/// Gives the ids of the containers in the `n` holders starting at `holders` back, once the containers left the platform
+/// (after `container_index_remove_all`, which needs their ULIDs); the holders are emptied
+void free_containers(container_holder_t* holders, size_t n);
+
 #endif // CONTAINER_H
@@ -0,0 +1,311 @@
+#include "container_index.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "assert.h"
+#include "cache_line.h"
+#include "shared_memory.h"
+
+struct container_index_entry {
+    unsigned char ulid[16];
+    /// NULL if the entry is free
+    const container_holder_t* holder;
+};
+
+/// Open-addressing table with linear probing; entries are removed by shifting back the entries that follow them,
+/// so that no tombstones are needed
+struct container_index_segment {
+    CACHE_ALIGNED pthread_mutex_t mutex;
+    struct container_index_entry* entries;
+    size_t capacity;
+    size_t length;
+
+    size_t lookups;
+    size_t max_probe;
+};
+
+/// Memory registered with `container_index_register`; ranges are only ever prepended, so they can be read without a lock
+struct container_range {
+    enum container_place place;
+    const char* begin;
+    size_t n;
+    size_t size;
+    struct container_range* next;
+};
+
+struct container_index {
+    struct container_index_segment segments[CONTAINER_INDEX_SEGMENTS];
+    _Atomic(struct container_range*) ranges;
+};
+
+/// Inherited by the agents' processes, like the shared region it lives in
+static struct container_index* container_index = NULL;
+
+void container_index_init() {
+    passert(container_index == NULL, "The container index already exists");
+
+    container_index = (struct container_index*)shared_aligned_alloc(CACHE_LINE_SIZE, sizeof(struct container_index));
+    memset(container_index, 0, sizeof(struct container_index));
+
+    pthread_mutexattr_t attributes;
+    passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_setpshared(&attributes, 1), 0);
+    for (size_t n = 0; n < CONTAINER_INDEX_SEGMENTS; n++) {
+        struct container_index_segment* segment = &container_index->segments[n];
+        passert_eq(int, "%d", pthread_mutex_init(&segment->mutex, &attributes), 0);
+        segment->entries = (struct container_index_entry*)shared_calloc(
+            CONTAINER_INDEX_CAPACITY,
+            sizeof(struct container_index_entry)
+        );
+        segment->capacity = CONTAINER_INDEX_CAPACITY;
+    }
+    passert_eq(int, "%d", pthread_mutexattr_destroy(&attributes), 0);
+
+    atomic_init(&container_index->ranges, NULL);
+}
+
+void container_index_free() {
+    if (container_index == NULL) return;
+
+    for (size_t n = 0; n < CONTAINER_INDEX_SEGMENTS; n++) {
+        shared_free(container_index->segments[n].entries);
+        pthread_mutex_destroy(&container_index->segments[n].mutex);
+    }
+
+    struct container_range* range = atomic_load(&container_index->ranges);
+    while (range != NULL) {
+        struct container_range* next = range->next;
+        shared_free(range);
+        range = next;
+    }
+
+    shared_free(container_index);
+    container_index = NULL;
+}
+
+void container_index_register(enum container_place place, const void* vehicles, size_t n, size_t size) {
+    if (container_index == NULL) return;
+
+    struct container_range* range = (struct container_range*)shared_malloc(sizeof(struct container_range));
+    range->place = place;
+    range->begin = (const char*)vehicles;
+    range->n = n;
+    range->size = size;
+
+    range->next = atomic_load(&container_index->ranges);
+    while (!atomic_compare_exchange_weak(&container_index->ranges, &range->next, range)) {}
+}
+
+/// Mixes the bits of the ULID: consecutive ULIDs only differ in their last bytes
+uint64_t container_index_hash(const unsigned char ulid[16]) {
+    uint64_t high, low;
+    memcpy(&high, ulid, 8);
+    memcpy(&low, ulid + 8, 8);
+
+    uint64_t res = high ^ low;
+    res ^= res >> 33;
+    res *= 0xff51afd7ed558ccdULL;
+    res ^= res >> 33;
+    res *= 0xc4ceb9fe1a85ec53ULL;
+    res ^= res >> 33;
+    return res;
+}
+
+struct container_index_segment* container_index_segment(uint64_t hash) {
+    // The low bits of the hash pick the entry within the segment
+    return &container_index->segments[(hash >> 48) & (CONTAINER_INDEX_SEGMENTS - 1)];
+}
+
+/// Returns the entry of `ulid` in `segment`, or the free entry where it should be inserted.
+/// Must be called while holding the segment's mutex
+struct container_index_entry* container_index_probe(
+    struct container_index_segment* segment,
+    uint64_t hash,
+    const unsigned char ulid[16]
+) {
+    size_t mask = segment->capacity - 1;
+    size_t n = hash & mask;
+    size_t probe = 1;
+
+    while (segment->entries[n].holder != NULL && memcmp(segment->entries[n].ulid, ulid, 16) != 0) {
+        n = (n + 1) & mask;
+        probe++;
+    }
+    if (probe > segment->max_probe) segment->max_probe = probe;
+
+    return &segment->entries[n];
+}
+
+/// Doubles the capacity of `segment`. Must be called while holding the segment's mutex
+void container_index_grow(struct container_index_segment* segment) {
+    struct container_index_entry* entries = segment->entries;
+    size_t capacity = segment->capacity;
+
+    segment->capacity *= 2;
+    segment->entries = (struct container_index_entry*)shared_calloc(
+        segment->capacity,
+        sizeof(struct container_index_entry)
+    );
+
+    for (size_t n = 0; n < capacity; n++) {
+        if (entries[n].holder == NULL) continue;
+        *container_index_probe(segment, container_index_hash(entries[n].ulid), entries[n].ulid) = entries[n];
+    }
+    shared_free(entries);
+}
+
+void container_index_place(const container_holder_t* holder) {
+    if (container_index == NULL || container_holder_is_empty(holder)) return;
+
+    const unsigned char* ulid = container_ulid(&holder->container);
+    uint64_t hash = container_index_hash(ulid);
+    struct container_index_segment* segment = container_index_segment(hash);
+
+    passert_eq(int, "%d", pthread_mutex_lock(&segment->mutex), 0);
+    struct container_index_entry* entry = container_index_probe(segment, hash, ulid);
+    if (entry->holder == NULL) {
+        memcpy(entry->ulid, ulid, 16);
+        segment->length++;
+    }
+    entry->holder = holder;
+
+    if (segment->length * 2 > segment->capacity) container_index_grow(segment);
+    passert_eq(int, "%d", pthread_mutex_unlock(&segment->mutex), 0);
+}
+
+void container_index_place_all(const container_holder_t* holders, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        container_index_place(&holders[i]);
+    }
+}
+
+/// Removes the entry of the container in `holder`, if it is still indexed there
+void container_index_remove(const container_holder_t* holder) {
+    if (container_index == NULL || container_holder_is_empty(holder)) return;
+
+    const unsigned char* ulid = container_ulid(&holder->container);
+    uint64_t hash = container_index_hash(ulid);
+    struct container_index_segment* segment = container_index_segment(hash);
+
+    passert_eq(int, "%d", pthread_mutex_lock(&segment->mutex), 0);
+    struct container_index_entry* entry = container_index_probe(segment, hash, ulid);
+    if (entry->holder == holder) {
+        size_t mask = segment->capacity - 1;
+        size_t hole = entry - segment->entries;
+        segment->entries[hole].holder = NULL;
+        segment->length--;
+
+        // Moves back the entries of the cluster that can't be reached from their home anymore
+        for (size_t n = (hole + 1) & mask; segment->entries[n].holder != NULL; n = (n + 1) & mask) {
+            size_t home = container_index_hash(segment->entries[n].ulid) & mask;
+            if (((n - home) & mask) >= ((n - hole) & mask)) {
+                segment->entries[hole] = segment->entries[n];
+                segment->entries[n].holder = NULL;
+                hole = n;
+            }
+        }
+    }
+    passert_eq(int, "%d", pthread_mutex_unlock(&segment->mutex), 0);
+}
+
+void container_index_remove_all(const container_holder_t* holders, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        container_index_remove(&holders[i]);
+    }
+}
+
+const container_holder_t* container_index_find(const unsigned char ulid[16]) {
+    if (container_index == NULL) return NULL;
+
+    uint64_t hash = container_index_hash(ulid);
+    struct container_index_segment* segment = container_index_segment(hash);
+
+    passert_eq(int, "%d", pthread_mutex_lock(&segment->mutex), 0);
+    const container_holder_t* res = container_index_probe(segment, hash, ulid)->holder;
+    segment->lookups++;
+    passert_eq(int, "%d", pthread_mutex_unlock(&segment->mutex), 0);
+
+    return res;
+}
+
+bool container_index_locate(const unsigned char ulid[16], container_location_t* location) {
+    const container_holder_t* holder = container_index_find(ulid);
+    if (holder == NULL) return false;
+
+    for (struct container_range* range = atomic_load(&container_index->ranges); range != NULL; range = range->next) {
+        const char* address = (const char*)holder;
+        if (address < range->begin || address >= range->begin + range->n * range->size) continue;
+
+        size_t offset = (address - range->begin) % range->size;
+        location->place = range->place;
+        location->vehicle = address - offset;
+        location->slot = offset / sizeof(container_holder_t);
+        location->holder = holder;
+        return true;
+    }
+
+    // The container was moved to a holder outside of the registered vehicles
+    return false;
+}
+
+const char* container_place_name(enum container_place place) {
+    static const char* PLACE_NAMES[] = {
+        [CONTAINER_ON_BOAT] = "boat",
+        [CONTAINER_ON_WAGON] = "wagon",
+        [CONTAINER_ON_TRUCK] = "truck",
+        [CONTAINER_AT_CRANE] = "crane",
+        [CONTAINER_IN_TRANSFER] = "transfer",
+        [CONTAINER_IN_YARD] = "yard",
+    };
+
+    return place <= CONTAINER_IN_YARD ? PLACE_NAMES[place] : "?";
+}
+
+void print_container_location(const container_location_t* location, bool newline) {
+    printf(
+        "Location { place = %s, vehicle = %p, slot = %zu }%s",
+        container_place_name(location->place),
+        location->vehicle,
+        location->slot,
+        newline ? "\n" : ""
+    );
+}
+
+void container_index_print() {
+    if (container_index == NULL) return;
+
+    size_t length = 0;
+    size_t capacity = 0;
+    size_t lookups = 0;
+    size_t max_probe = 0;
+    size_t misplaced = 0;
+
+    for (size_t n = 0; n < CONTAINER_INDEX_SEGMENTS; n++) {
+        struct container_index_segment* segment = &container_index->segments[n];
+        passert_eq(int, "%d", pthread_mutex_lock(&segment->mutex), 0);
+
+        length += segment->length;
+        capacity += segment->capacity;
+        lookups += segment->lookups;
+        if (segment->max_probe > max_probe) max_probe = segment->max_probe;
+
+        for (size_t e = 0; e < segment->capacity; e++) {
+            const struct container_index_entry* entry = &segment->entries[e];
+            if (entry->holder == NULL) continue;
+            if (container_holder_is_empty(entry->holder) || memcmp(container_ulid(&entry->holder->container), entry->ulid, 16) != 0) misplaced++;
+        }
+
+        passert_eq(int, "%d", pthread_mutex_unlock(&segment->mutex), 0);
+    }
+
+    printf(
+        "ContainerIndex { containers = %zu, capacity = %zu, lookups = %zu, max_probe = %zu, misplaced = %zu }\n",
+        length,
+        capacity,
+        lookups,
+        max_probe,
+        misplaced
+    );
+}
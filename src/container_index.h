@@ -0,0 +1,92 @@
+/*! # container_index.h
+
+Index of the containers on the platform, mapping the ULID of each container to the holder it currently sits in.
+
+The index is kept up to date by `transfer_container`, and by the control tower as vehicles arrive and leave, so any agent
+(or a monitoring thread) can find a container in constant time while the cranes keep moving containers around.
+
+The index is split into `CONTAINER_INDEX_SEGMENTS` open-addressing tables, each protected by its own (process-shared)
+mutex, so that the two cranes of a terminal (and the cranes of other terminals) rarely contend on the same lock.
+Vehicles register the memory they live in with `container_index_register`, which lets a holder be traced back
+to its vehicle and slot.
+*/
+
+#ifndef CONTAINER_INDEX_H
+#define CONTAINER_INDEX_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "container.h"
+
+/// The number of independently locked tables of the index; must be a power of two.
+/// Can be overriden at compile time with `make DEFINES="CONTAINER_INDEX_SEGMENTS=..."`
+#ifndef CONTAINER_INDEX_SEGMENTS
+#define CONTAINER_INDEX_SEGMENTS 64
+#endif
+
+/// The initial number of entries of each table, which doubles whenever the table becomes half full
+#define CONTAINER_INDEX_CAPACITY 16
+
+enum container_place {
+    CONTAINER_ON_BOAT,
+    CONTAINER_ON_WAGON,
+    CONTAINER_ON_TRUCK,
+    /// In the inbound buffer of a crane, see `terminal.h`
+    CONTAINER_AT_CRANE,
+    /// In the transfer channel of a terminal, see `terminal.h`
+    CONTAINER_IN_TRANSFER,
+    /// In the yard of a crane, see `yard.h`
+    CONTAINER_IN_YARD,
+};
+#define N_CONTAINER_PLACES 6
+
+struct container_location {
+    enum container_place place;
+    /// The vehicle (`boat_t`, `wagon_t` or `truck_t`) holding the container; for the other places,
+    /// the array of holders that the container is in
+    const void* vehicle;
+    /// The index of the holder among the ones of the vehicle (or of the array)
+    size_t slot;
+    const container_holder_t* holder;
+};
+typedef struct container_location container_location_t;
+
+/// Creates the index; until it is called, the other functions do nothing.
+/// In multi-process mode, must be called after `shared_memory_init` and before the agents are started
+void container_index_init();
+
+/// Frees the index, once no container moves anymore
+void container_index_free();
+
+/// Registers `n` vehicles of `size` bytes starting at `vehicles`, each of them starting with its container holders
+/// (the vehicles may also be plain arrays of holders). The memory must stay valid until `container_index_free`
+void container_index_register(enum container_place place, const void* vehicles, size_t n, size_t size);
+
+/// Records that the container in `holder` (if any) is now there
+void container_index_place(const container_holder_t* holder);
+
+/// Records that the containers in the `n` holders starting at `holders` are now there
+void container_index_place_all(const container_holder_t* holders, size_t n);
+
+/// Records that the containers in the `n` holders starting at `holders` left the platform
+void container_index_remove_all(const container_holder_t* holders, size_t n);
+
+/// Returns the holder of the container `ulid`, or NULL if it isn't on the platform.
+/// The container may be moved to another holder by the cranes as soon as the function returns
+const container_holder_t* container_index_find(const unsigned char ulid[16]);
+
+/// Finds the container `ulid` and the vehicle holding it; returns false if it isn't on the platform,
+/// or if the holder it sits in wasn't registered with `container_index_register`
+bool container_index_locate(const unsigned char ulid[16], container_location_t* location);
+
+/// Returns a short name for `place`
+const char* container_place_name(enum container_place place);
+
+/// Used for debugging
+void print_container_location(const container_location_t* location, bool newline);
+
+/// Prints the size of the index and how many lookups it served.
+/// Once the agents stopped, also checks that every indexed container is in the holder it is indexed at
+void container_index_print();
+
+#endif // CONTAINER_INDEX_H
@@ -1,9 +1,18 @@
 #include "control_tower.h"
 #include "assert.h"
-
-control_tower_t new_control_tower() {
-    control_tower_t res;
-    res.message_queue = NULL;
+#include "terminal.h"
+#include "shared_memory.h"
+#include "container_index.h"
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+
+dispatcher_t new_dispatcher(size_t queue_capacity) {
+    dispatcher_t res;
+    res.queue = new_message_queue(queue_capacity);
+    res.tower = NULL;
+    res.index = 0;
 
     pthread_mutexattr_t attributes;
     passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
@@ -14,89 +23,267 @@ control_tower_t new_control_tower() {
     pthread_condattr_t cond_attributes;
     passert_eq(int, "%d", pthread_condattr_init(&cond_attributes), 0);
     passert_eq(int, "%d", pthread_condattr_setpshared(&cond_attributes, 1), 0);
+    // Deadlines of `control_tower_receive` are on the tower's clock
+    passert_eq(int, "%d", pthread_condattr_setclock(&cond_attributes, CLOCK_MONOTONIC), 0);
     passert_eq(int, "%d", pthread_cond_init(&res.message_monitor, &cond_attributes), 0);
+    passert_eq(int, "%d", pthread_cond_init(&res.room_monitor, &cond_attributes), 0);
     passert_eq(int, "%d", pthread_condattr_destroy(&cond_attributes), 0);
 
     return res;
 }
 
+control_tower_t new_control_tower(size_t queue_capacity) {
+    control_tower_t res;
+    for (size_t d = 0; d < N_DISPATCHERS; d++) {
+        res.dispatchers[d] = new_dispatcher(queue_capacity);
+        res.dispatchers[d].index = d;
+    }
+    res.n_dispatchers = 1;
+    res.backpressure = BACKPRESSURE_BLOCK;
+    res.stats = NULL;
+    res.arrivals = NULL;
+    res.terminal = NULL;
+
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        res.processes[k] = new_arrival_process();
+    }
+    res.duration = ARRIVAL_DEFAULT_DURATION / 1000.0;
+    res.start = arrival_clock();
+    res.train_pool = new_train_pool(TRAIN_PIPELINE);
+    res.boat_store = new_boat_store();
+    res.trains = new_train_pipeline();
+
+    // One more truck than N_TRUCKS is parked at crane α from the start
+    res.n_trucks = N_TRUCKS + 1;
+    res.trucks = (truck_t*)shared_calloc(res.n_trucks, sizeof(truck_t));
+    passert_neq(truck_t*, "%p", res.trucks, NULL);
+    // Zeroed holders would hold containers for the first destination, whose ids were never handed out
+    for (size_t n = 0; n < res.n_trucks; n++) {
+        vehicle_fill(res.trucks[n].containers, TRUCK_CONTAINERS, 0, 0);
+    }
+    container_index_register(CONTAINER_ON_TRUCK, res.trucks, res.n_trucks, sizeof(truck_t));
+    res.free_trucks = (size_t*)shared_malloc(res.n_trucks * sizeof(size_t));
+    passert_neq(size_t*, "%p", res.free_trucks, NULL);
+    res.n_free_trucks = 0;
+
+    // An epoch of zero is used by the cranes to tell that they aren't stuck
+    atomic_init(&res.epoch, 1);
+    atomic_init(&res.in_flight, 0);
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        atomic_init(&res.arrivals_over[k], false);
+    }
+    atomic_init(&res.stopped, false);
+
+    res.cpu = new_cpu_tracker();
+
+    return res;
+}
+
 void free_control_tower(control_tower_t* control_tower) {
-    // if (control_tower->message_queue != NULL) {
-    //     free_message(control_tower->message_queue);
-    // }
+    free_train_pool(&control_tower->train_pool);
+    free_boat_store(&control_tower->boat_store);
+    shared_free(control_tower->trucks);
+    shared_free(control_tower->free_trucks);
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        free_arrival_process(&control_tower->processes[k]);
+    }
+
+    for (size_t d = 0; d < N_DISPATCHERS; d++) {
+        free_message_queue(&control_tower->dispatchers[d].queue);
+        pthread_mutex_destroy(&control_tower->dispatchers[d].message_mutex);
+        pthread_cond_destroy(&control_tower->dispatchers[d].message_monitor);
+        pthread_cond_destroy(&control_tower->dispatchers[d].room_monitor);
+    }
+}
+
+/// Returns the dispatcher handling messages of type `type`
+dispatcher_t* control_tower_dispatcher(control_tower_t* tower, enum message_type type) {
+    if (tower->n_dispatchers == 1) return &tower->dispatchers[0];
+
+    switch (type) {
+        case BOAT_EMPTY:
+        case BOAT_FULL:
+            return &tower->dispatchers[ARRIVAL_BOAT];
+        case WAGON_FULL:
+        case WAGON_EMPTY:
+            return &tower->dispatchers[ARRIVAL_TRAIN];
+        default:
+            return &tower->dispatchers[ARRIVAL_TRUCK];
+    }
+}
 
-    pthread_mutex_destroy(&control_tower->message_mutex);
-    pthread_cond_destroy(&control_tower->message_monitor);
+/// Returns true if `dispatcher` lets in the vehicles of the kind `kind`
+bool dispatcher_dispatches(const dispatcher_t* dispatcher, enum arrival_kind kind) {
+    return dispatcher->tower->n_dispatchers == 1 || dispatcher->index == (size_t)kind;
 }
 
 void control_tower_send(control_tower_t* tower, message_t* message) {
+    dispatcher_t* dispatcher = control_tower_dispatcher(tower, message->type);
+
     // S(γ).P()
-    passert_eq(int, "%d", pthread_mutex_lock(&tower->message_mutex), 0);
+    passert_eq(int, "%d", pthread_mutex_lock(&dispatcher->message_mutex), 0);
+
+    if (message_queue_full(&dispatcher->queue)) {
+        // The stuck crane will notice that the epoch changed once the messages in the queue are handled, and try again
+        if (tower->backpressure == BACKPRESSURE_SHED && message->type == CRANE_STUCK) {
+            stats_add_shared(&tower->stats->queue.shed, 1);
+            passert_eq(int, "%d", pthread_mutex_unlock(&dispatcher->message_mutex), 0);
+            free_message(message);
+            return;
+        }
 
-    // Q(γ).send(message)
-    message_t* current_message = tower->message_queue;
-    if (current_message == NULL) {
-        tower->message_queue = message;
-    } else {
-        while (current_message->next != NULL) {
-            current_message = current_message->next;
+        stats_add_shared(&tower->stats->queue.waited, 1);
+        while (message_queue_full(&dispatcher->queue) && !atomic_load(&tower->stopped)) {
+            if (tower->backpressure == BACKPRESSURE_SPIN) {
+                passert_eq(int, "%d", pthread_mutex_unlock(&dispatcher->message_mutex), 0);
+                sched_yield();
+                passert_eq(int, "%d", pthread_mutex_lock(&dispatcher->message_mutex), 0);
+            } else {
+                passert_eq(int, "%d", pthread_cond_wait(&dispatcher->room_monitor, &dispatcher->message_mutex), 0);
+            }
+        }
+
+        // Nobody makes room once the tower stopped, and the message would never be handled anyway
+        if (message_queue_full(&dispatcher->queue)) {
+            passert_eq(int, "%d", pthread_mutex_unlock(&dispatcher->message_mutex), 0);
+            free_message(message);
+            return;
         }
-        current_message->next = message;
     }
 
+    // Q(γ).send(message)
+    control_tower_message_sent(tower, message);
+    message_queue_push(&dispatcher->queue, message, &tower->stats->queue);
+
     // M(γ).signal(S(γ))
-    passert_eq(int, "%d", pthread_cond_broadcast(&tower->message_monitor), 0);
-    passert_eq(int, "%d", pthread_mutex_unlock(&tower->message_mutex), 0);
+    passert_eq(int, "%d", pthread_cond_broadcast(&dispatcher->message_monitor), 0);
+    passert_eq(int, "%d", pthread_mutex_unlock(&dispatcher->message_mutex), 0);
 }
 
-message_t* control_tower_receive(control_tower_t* tower) {
+message_t* control_tower_receive(dispatcher_t* dispatcher, double deadline) {
+    control_tower_t* tower = dispatcher->tower;
+
     // M(γ).wait()
-    passert_eq(int, "%d", pthread_mutex_lock(&tower->message_mutex), 0);
+    passert_eq(int, "%d", pthread_mutex_lock(&dispatcher->message_mutex), 0);
 
-    if (tower->message_queue != NULL) {
-        // message = Q(γ).read()
-        message_t* res = tower->message_queue;
-        tower->message_queue = res->next;
-        res->next = NULL;
-        passert_eq(int, "%d", pthread_mutex_unlock(&tower->message_mutex), 0);
-        return res;
+    while (dispatcher->queue.length == 0) {
+        if (atomic_load(&tower->stopped)) {
+            passert_eq(int, "%d", pthread_mutex_unlock(&dispatcher->message_mutex), 0);
+            return NULL;
+        }
+
+        if (deadline == INFINITY) {
+            passert_eq(int, "%d", pthread_cond_wait(&dispatcher->message_monitor, &dispatcher->message_mutex), 0);
+            continue;
+        }
+
+        double time = tower->start + deadline;
+        struct timespec until;
+        until.tv_sec = (time_t)time;
+        until.tv_nsec = (long)((time - until.tv_sec) * 1e9);
+
+        int res = pthread_cond_timedwait(&dispatcher->message_monitor, &dispatcher->message_mutex, &until);
+        if (res == ETIMEDOUT && dispatcher->queue.length == 0) {
+            passert_eq(int, "%d", pthread_mutex_unlock(&dispatcher->message_mutex), 0);
+            return NULL;
+        }
+        passert(res == 0 || res == ETIMEDOUT, "pthread_cond_timedwait failed");
     }
-    passert_eq(int, "%d", pthread_cond_wait(&tower->message_monitor, &tower->message_mutex), 0);
+
     // message = Q(γ).read()
-    message_t* res = tower->message_queue;
+    bool full = message_queue_full(&dispatcher->queue);
+    message_t* res = message_queue_pop(&dispatcher->queue, &tower->stats->queue);
     passert_neq(message_t*, "%p", res, NULL);
 
-    tower->message_queue = res->next;
-    res->next = NULL;
+    // Wake up the cranes waiting for room in the queue
+    if (full) passert_eq(int, "%d", pthread_cond_broadcast(&dispatcher->room_monitor), 0);
 
     // S(γ).V()
-    passert_eq(int, "%d", pthread_mutex_unlock(&tower->message_mutex), 0);
+    passert_eq(int, "%d", pthread_mutex_unlock(&dispatcher->message_mutex), 0);
 
     return res;
 }
 
-void control_tower_new_truck(control_tower_t* tower, truck_t* truck) {
-    if (rand() % 2 == 0) {
-        *truck = empty_truck(rand() % N_DESTINATIONS);
-    } else {
-        *truck = new_truck(rand() % N_DESTINATIONS);
+double control_tower_time(control_tower_t* tower) {
+    return arrival_clock() - tower->start;
+}
+
+size_t control_tower_epoch(control_tower_t* tower) {
+    return atomic_load(&tower->epoch);
+}
+
+void control_tower_progress(control_tower_t* tower) {
+    atomic_fetch_add(&tower->epoch, 1);
+}
+
+void control_tower_message_sent(control_tower_t* tower, message_t* message) {
+    atomic_fetch_add(&tower->in_flight, 1);
+    if (message->type != CRANE_STUCK) control_tower_progress(tower);
+}
+
+void control_tower_message_handled(control_tower_t* tower) {
+    atomic_fetch_sub(&tower->in_flight, 1);
+}
+
+bool control_tower_is_stuck(control_tower_t* tower) {
+    size_t epoch = atomic_load(&tower->epoch);
+
+    bool over = true;
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        over = over && atomic_load(&tower->arrivals_over[k]);
     }
 
+    return over
+        && atomic_load(&tower->in_flight) == 0
+        && atomic_load(&tower->crane_alpha->stuck_epoch) == epoch
+        && atomic_load(&tower->crane_beta->stuck_epoch) == epoch;
+}
+
+/// Returns the next boat of the arrival log if there is one, or a new boat otherwise (which gets recorded)
+boat_t* control_tower_next_boat(control_tower_t* tower, size_t destination, size_t n_cargo) {
+    boat_t* boat = boat_store_alloc(&tower->boat_store);
+    if (!arrival_log_read_boat(tower->arrivals, boat)) {
+        init_boat(boat, destination, n_cargo);
+        arrival_log_write_boat(tower->arrivals, boat);
+    }
+    container_index_place_all(boat->containers, BOAT_CONTAINERS);
+    return boat;
+}
+
+/// Creates a new truck in place of `truck`, which arrived at the time `arrived`
+void control_tower_new_truck(control_tower_t* tower, truck_t* truck, double arrived) {
+    size_t crane;
+    if (!arrival_log_read_truck(tower->arrivals, truck, &crane)) {
+        if (rand() % 2 == 0) {
+            *truck = empty_truck(terminal_destination(tower->terminal));
+        } else {
+            *truck = new_truck(terminal_destination(tower->terminal));
+        }
+        crane = rand() % 2;
+        arrival_log_write_truck(tower->arrivals, truck, crane);
+    }
+    truck->arrived = arrived;
+    container_index_place_all(truck->containers, TRUCK_CONTAINERS);
+    arrival_process_arrived(&tower->processes[ARRIVAL_TRUCK], control_tower_time(tower));
+
     union message_data msg_data;
     msg_data.truck = truck;
 
     message_t* message = new_message(TRUCK_NEW, msg_data);
 
-    if (rand() % 2 == 0) {
+    if (crane == 0) {
         crane_send(tower->crane_alpha, message);
     } else {
         crane_send(tower->crane_beta, message);
     }
 }
 
-void control_tower_new_boat(control_tower_t* tower) {
-    boat_t boat = new_boat(rand() % N_DESTINATIONS, rand() % (BOAT_CONTAINERS - 1) + 1);
+void control_tower_new_boat(control_tower_t* tower, double arrived) {
+    boat_t* boat = control_tower_next_boat(tower, terminal_destination(tower->terminal), rand() % (BOAT_CONTAINERS - 1) + 1);
+    boat->arrived = arrived;
+    arrival_process_arrived(&tower->processes[ARRIVAL_BOAT], control_tower_time(tower));
 
+    stats_set(&tower->stats->boats_in_use, tower->boat_store.in_use);
     boat_lane_t* boat_lane = &tower->crane_alpha->boat_lane;
 
     boat_lane_lock(boat_lane);
@@ -124,173 +311,372 @@ void control_tower_transfer_wagons(control_tower_t* tower, train_t* train) {
     train_lane_unlock(lane_alpha);
 }
 
-void control_tower_new_train(control_tower_t* tower, train_t** train) {
-    *train = new_train(rand() % N_DESTINATIONS, rand() % TRAIN_WAGONS);
+void control_tower_new_train(control_tower_t* tower, train_pipeline_t* pipeline, double arrived) {
+    train_t* train = train_pool_alloc(&tower->train_pool);
+    if (!arrival_log_read_train(tower->arrivals, train)) {
+        init_train(train, terminal_destination(tower->terminal), rand() % TRAIN_WAGONS);
+        arrival_log_write_train(tower->arrivals, train);
+    }
+    train->arrived = arrived;
+    for (size_t n = 0; n < train->n_wagons; n++) {
+        container_index_place_all(train->wagons[n].containers, WAGON_CONTAINERS);
+    }
+    arrival_process_arrived(&tower->processes[ARRIVAL_TRAIN], control_tower_time(tower));
+    train_pipeline_push(pipeline, train);
+    stats_set(&tower->stats->trains_in_use, tower->train_pool.in_use);
+
     train_lane_lock(&tower->crane_beta->train_lane);
-    for (size_t n = 0; n < (*train)->n_wagons; n++) {
-        train_lane_append(&tower->crane_beta->train_lane, &(*train)->wagons[n]);
+    for (size_t n = 0; n < train->n_wagons; n++) {
+        train_lane_append(&tower->crane_beta->train_lane, &train->wagons[n]);
     }
     train_lane_unlock(&tower->crane_beta->train_lane);
 }
 
-void control_tower_send_train(control_tower_t* tower, train_t** train) {
+void control_tower_send_train(control_tower_t* tower, train_pipeline_t* pipeline) {
     train_lane_t* lane_alpha = &tower->crane_alpha->train_lane;
+    train_t* train = train_pipeline_pop(pipeline);
 
+    printf("Train => %s (%zu)\n", DESTINATION_NAMES[train->destination], train->destination);
+    stats_add(&tower->stats->trains_departed, 1);
+    double now = control_tower_time(tower);
+    arrival_process_departed(&tower->processes[ARRIVAL_TRAIN], now, now - train->arrived);
+
+    // The tail of the pipeline is always at the head of α's lane
     train_lane_lock(lane_alpha);
-    train_lane_shift(lane_alpha, (*train)->n_wagons);
+    train_lane_shift(lane_alpha, train->n_wagons);
     train_lane_unlock(lane_alpha);
 
-    control_tower_new_train(tower, train);
+    for (size_t n = 0; n < train->n_wagons; n++) {
+        container_index_remove_all(train->wagons[n].containers, WAGON_CONTAINERS);
+        free_containers(train->wagons[n].containers, WAGON_CONTAINERS);
+    }
+
+    // None of its wagons are in a lane anymore, so the train can be reused
+    train_pool_release(&tower->train_pool, train);
+
+    if (!arrival_process_timed(&tower->processes[ARRIVAL_TRAIN])) {
+        control_tower_new_train(tower, pipeline, control_tower_time(tower));
+    }
 }
 
-void* control_tower_entry(void* data) {
-    srand(time(0));
-    control_tower_t* control_tower = (control_tower_t*)data;
+void control_tower_update_trains(control_tower_t* tower, train_pipeline_t* pipeline) {
+    bool progress = true;
+    while (progress) {
+        progress = false;
+
+        // Transfer the empty wagons at the head of the pipeline to α
+        train_t* head = train_pipeline_head(pipeline);
+        if (head != NULL && head->offset < head->n_wagons && head->wagon_empty[head->offset]) {
+            printf("Train %zu ... transfer\n", pipeline->head);
+            control_tower_transfer_wagons(tower, head);
+            progress = true;
+        }
+        if (head != NULL && head->offset == head->n_wagons) {
+            pipeline->head++;
+            progress = true;
+        }
 
-    // Create a bunch of trucks :)
-    truck_t* trucks = malloc(sizeof(truck_t) * N_TRUCKS);
-    for (size_t n = 0; n < N_TRUCKS; n++) {
-        control_tower_new_truck(control_tower, &trucks[n]);
+        // Send the tail of the pipeline away once it has been fully loaded
+        train_t* tail = train_pipeline_tail(pipeline);
+        if (tail != NULL && pipeline->head > 0 && train_is_full(tail)) {
+            control_tower_send_train(tower, pipeline);
+            progress = true;
+        }
     }
+}
 
-    for (size_t n = 0; n < N_BOATS; n++) {
-        control_tower_new_boat(control_tower);
+/// Lets the vehicles of the kind `kind` that are due onto the platform, as long as there is room for them;
+/// returns true if any arrived
+bool control_tower_arrive_kind(control_tower_t* tower, enum arrival_kind kind, double now) {
+    arrival_process_t* process = &tower->processes[kind];
+    arrival_process_update(process, now);
+
+    bool res = false;
+    switch (kind) {
+        case ARRIVAL_TRUCK:
+            while (process->n_backlog > 0 && tower->n_free_trucks > 0) {
+                tower->n_free_trucks--;
+                control_tower_new_truck(tower, &tower->trucks[tower->free_trucks[tower->n_free_trucks]], arrival_process_pop(process));
+                res = true;
+            }
+            break;
+        case ARRIVAL_BOAT:
+            while (process->n_backlog > 0) {
+                control_tower_new_boat(tower, arrival_process_pop(process));
+                res = true;
+            }
+            break;
+        case ARRIVAL_TRAIN:
+            while (process->n_backlog > 0 && tower->trains.length < TRAIN_PIPELINE) {
+                control_tower_new_train(tower, &tower->trains, arrival_process_pop(process));
+                res = true;
+            }
+            if (res) control_tower_update_trains(tower, &tower->trains);
+            break;
     }
 
-    train_t* trains[2];
-    size_t first_train = 0;
+    atomic_store(&tower->arrivals_over[kind], arrival_process_over(process));
+    return res;
+}
 
-    control_tower_new_train(control_tower, &trains[0]);
-    control_tower_new_train(control_tower, &trains[1]);
+/// Lets the vehicles that `dispatcher` lets in and that are due onto the platform; returns true if any arrived
+bool control_tower_arrive(dispatcher_t* dispatcher) {
+    double now = control_tower_time(dispatcher->tower);
 
-    train_lane_print(&control_tower->crane_beta->train_lane, true);
+    bool res = false;
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        if (dispatcher_dispatches(dispatcher, k)) {
+            res = control_tower_arrive_kind(dispatcher->tower, k, now) || res;
+        }
+    }
+    return res;
+}
 
-    bool loop = true;
-    while (loop) {
-        message_t* message = control_tower_receive(control_tower);
+/// Returns the time at which the next vehicle that `dispatcher` lets in is due, or INFINITY if none is
+double control_tower_next_arrival(dispatcher_t* dispatcher) {
+    double res = INFINITY;
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        if (!dispatcher_dispatches(dispatcher, k)) continue;
+        if (dispatcher->tower->processes[k].next < res) res = dispatcher->tower->processes[k].next;
+    }
+    return res;
+}
 
-        // print_message(message);
+void control_tower_populate(control_tower_t* tower) {
+    double now = control_tower_time(tower);
 
-        switch (message->type) {
-            case TRUCK_NEW:
-                passert(false, "Control tower may not receive a TRUCK_NEW message!\n");
-                break;
-            case TRUCK_FULL: { // truck is full, send it away and generate a new one
-                truck_t* truck = message->data.truck;
-                printf("Truck => %s (%zu)\n", DESTINATION_NAMES[truck->destination], truck->destination);
+    if (!arrival_process_timed(&tower->processes[ARRIVAL_BOAT])) {
+        // A full boat is waiting at crane α from the start
+        size_t destination = terminal_serves(tower->terminal, 1) ? 1 : terminal_destination(tower->terminal);
+        boat_t* boat = control_tower_next_boat(tower, destination, 5);
+        boat->arrived = now;
+        arrival_process_arrived(&tower->processes[ARRIVAL_BOAT], now);
+        boat_deque_push_back(tower->crane_alpha->boat_lane.queue, boat);
+    }
 
-                control_tower_new_truck(control_tower, truck);
-                break;
-            }
-            case TRUCK_EMPTY: { // truck is empty, move it to the other crane
-                truck_t* truck = message->data.truck;
-                truck->loading = true;
+    if (arrival_process_timed(&tower->processes[ARRIVAL_TRUCK])) {
+        // Trucks take a free slot as they arrive
+        for (size_t n = tower->n_trucks; n > 0; n--) {
+            tower->free_trucks[tower->n_free_trucks++] = n - 1;
+        }
+    } else {
+        // An empty truck is waiting at crane α from the start
+        size_t crane;
+        if (!arrival_log_read_truck(tower->arrivals, &tower->trucks[N_TRUCKS], &crane)) {
+            size_t destination = terminal_serves(tower->terminal, 2) ? 2 : terminal_destination(tower->terminal);
+            tower->trucks[N_TRUCKS] = empty_truck(destination);
+            arrival_log_write_truck(tower->arrivals, &tower->trucks[N_TRUCKS], 0);
+        }
+        tower->trucks[N_TRUCKS].arrived = now;
+        container_index_place_all(tower->trucks[N_TRUCKS].containers, TRUCK_CONTAINERS);
+        arrival_process_arrived(&tower->processes[ARRIVAL_TRUCK], now);
+        truck_lane_push(&tower->crane_alpha->truck_lane, &tower->trucks[N_TRUCKS]);
+
+        // Create a bunch of trucks :)
+        for (size_t n = 0; n < N_TRUCKS; n++) {
+            control_tower_new_truck(tower, &tower->trucks[n], now);
+        }
+    }
 
-                union message_data msg_data;
-                msg_data.truck = truck;
+    if (!arrival_process_timed(&tower->processes[ARRIVAL_BOAT])) {
+        for (size_t n = 0; n < N_BOATS; n++) {
+            control_tower_new_boat(tower, now);
+        }
+    }
 
-                message_t* message = new_message(TRUCK_EMPTY, msg_data);
+    if (!arrival_process_timed(&tower->processes[ARRIVAL_TRAIN])) {
+        for (size_t n = 0; n < TRAIN_PIPELINE; n++) {
+            control_tower_new_train(tower, &tower->trains, now);
+        }
+        control_tower_update_trains(tower, &tower->trains);
+    }
+}
 
-                if (message->sender == control_tower->crane_alpha->thread) {
-                    crane_send(control_tower->crane_beta, message);
-                } else {
-                    crane_send(control_tower->crane_alpha, message);
-                }
-                break;
-            }
-            case BOAT_FULL: { // boat is full, send it away and generate a new one
-                boat_t boat = message->data.boat;
-                printf("Boat => %s (%zu)\n", DESTINATION_NAMES[boat.destination], boat.destination);
+/// Tells both cranes to stop, and wakes the other dispatchers and the cranes waiting for room up so that they return;
+/// only the first call does anything
+void control_tower_stop(control_tower_t* tower) {
+    if (atomic_exchange(&tower->stopped, true)) return;
+
+    union message_data msg_data;
+    msg_data.stuck = true;
+    crane_send(tower->crane_beta, new_message(CRANE_STUCK, msg_data));
+    crane_send(tower->crane_alpha, new_message(CRANE_STUCK, msg_data));
+
+    for (size_t d = 0; d < tower->n_dispatchers; d++) {
+        dispatcher_t* dispatcher = &tower->dispatchers[d];
+        passert_eq(int, "%d", pthread_mutex_lock(&dispatcher->message_mutex), 0);
+        passert_eq(int, "%d", pthread_cond_broadcast(&dispatcher->message_monitor), 0);
+        passert_eq(int, "%d", pthread_cond_broadcast(&dispatcher->room_monitor), 0);
+        passert_eq(int, "%d", pthread_mutex_unlock(&dispatcher->message_mutex), 0);
+    }
+}
 
-                control_tower_new_boat(control_tower);
-                break;
+/// Handles a message sent to the tower
+void control_tower_handle(control_tower_t* tower, message_t* message) {
+    switch (message->type) {
+        case TRUCK_NEW:
+            passert(false, "Control tower may not receive a TRUCK_NEW message!\n");
+            break;
+        case TRUCK_FULL: { // truck is full, send it away and generate a new one
+            truck_t* truck = message->data.truck;
+            printf("Truck => %s (%zu)\n", DESTINATION_NAMES[truck->destination], truck->destination);
+            stats_add(&tower->stats->trucks_departed, 1);
+            double now = control_tower_time(tower);
+            arrival_process_departed(&tower->processes[ARRIVAL_TRUCK], now, now - truck->arrived);
+            container_index_remove_all(truck->containers, TRUCK_CONTAINERS);
+            free_containers(truck->containers, TRUCK_CONTAINERS);
+
+            if (arrival_process_timed(&tower->processes[ARRIVAL_TRUCK])) {
+                tower->free_trucks[tower->n_free_trucks++] = truck - tower->trucks;
+            } else {
+                control_tower_new_truck(tower, truck, now);
             }
-            case BOAT_EMPTY: { // boat is empty, move it to crane_beta
-                boat_t boat = message->data.boat;
-                // print_boat(&boat, true);
+            break;
+        }
+        case TRUCK_EMPTY: { // truck is empty, move it to the other crane
+            truck_t* truck = message->data.truck;
+            truck->loading = true;
 
-                boat_lane_t* boat_lane = &control_tower->crane_beta->boat_lane;
+            union message_data msg_data;
+            msg_data.truck = truck;
 
-                boat_lane_lock(boat_lane);
-                boat_deque_push_back(boat_lane->queue, boat);
-                boat_lane_unlock(boat_lane);
-                break;
-            }
-            case WAGON_EMPTY: { // wagon is empty, flag it as such
-                // printf("WAGON_EMPTY\n");
-                wagon_t* wagon = message->data.wagon;
-                // print_wagon(wagon, true);
-
-                for (size_t t = 0; t < 2; t++) {
-                    for (size_t n = 0; n < trains[t]->n_wagons; n++) {
-                        if (&trains[t]->wagons[n] == wagon) {
-                            trains[t]->wagon_empty[n] = true;
-                        }
-                    }
-                }
-
-                // If the head wagons are empty
-                // ISSUE: This may rarely fail
-                if (
-                    trains[first_train]->offset < trains[first_train]->n_wagons
-                    && trains[first_train]->wagon_empty[trains[first_train]->offset]
-                ) {
-                    printf("Train %zu ... transfer\n", first_train);
-                    control_tower_transfer_wagons(control_tower, trains[first_train]);
-                    // train_lane_print(&control_tower->crane_alpha->train_lane, true);
-                    // train_lane_print(&control_tower->crane_beta->train_lane, true);
-
-                    if (trains[first_train]->offset == trains[first_train]->n_wagons) {
-                        first_train = 1 - first_train;
-                    }
-                }
-                break;
-            }
-            case WAGON_FULL: {
-                // printf("WAGON_FULL\n");
-                wagon_t* wagon = message->data.wagon;
-                // print_wagon(wagon, true);
-
-                for (size_t t = 0; t < 2; t++) {
-                    bool is_full = true;
-                    for (size_t n = 0; n < trains[t]->n_wagons; n++) {
-                        if (&trains[t]->wagons[n] == wagon) {
-                            trains[t]->wagon_full[n] = true;
-                        }
-                        if (!trains[t]->wagon_full[n]) is_full = false;
-                    }
-                    if (is_full) {
-                        printf("Train => %s (%zu)\n", DESTINATION_NAMES[trains[t]->destination], trains[t]->destination);
-                        control_tower_send_train(control_tower, &trains[t]);
-                    }
-                }
-                break;
+            message_t* message = new_message(TRUCK_EMPTY, msg_data);
+
+            if (message->sender == tower->crane_alpha->thread) {
+                crane_send(tower->crane_beta, message);
+            } else {
+                crane_send(tower->crane_alpha, message);
             }
-            case CRANE_STUCK: {
-                // Check if both cranes are stuck
-                pthread_mutex_lock(&control_tower->crane_alpha->stuck_mutex);
-                bool alpha_stuck = control_tower->crane_alpha->stuck;
-                pthread_mutex_unlock(&control_tower->crane_alpha->stuck_mutex);
-                pthread_mutex_lock(&control_tower->crane_alpha->stuck_mutex);
-                bool beta_stuck = control_tower->crane_beta->stuck;
-                pthread_mutex_unlock(&control_tower->crane_alpha->stuck_mutex);
-
-                if (alpha_stuck && beta_stuck) {
-                    union message_data msg_data;
-                    msg_data.stuck = true;
-                    message_t* message = new_message(CRANE_STUCK, msg_data);
-                    crane_send(control_tower->crane_beta, message);
-                    crane_send(control_tower->crane_alpha, message);
-                    loop = false;
-                }
+            break;
+        }
+        case BOAT_FULL: { // boat is full, send it away and generate a new one
+            boat_t* boat = message->data.boat;
+            printf("Boat => %s (%zu)\n", DESTINATION_NAMES[boat->destination], boat->destination);
+            stats_add(&tower->stats->boats_departed, 1);
+            double now = control_tower_time(tower);
+            arrival_process_departed(&tower->processes[ARRIVAL_BOAT], now, now - boat->arrived);
+            container_index_remove_all(boat->containers, BOAT_CONTAINERS);
+            free_containers(boat->containers, BOAT_CONTAINERS);
+
+            boat_store_release(&tower->boat_store, boat);
+
+            if (!arrival_process_timed(&tower->processes[ARRIVAL_BOAT])) {
+                control_tower_new_boat(tower, now);
             }
+            break;
         }
+        case BOAT_EMPTY: { // boat is empty, move it to crane_beta
+            boat_t* boat = message->data.boat;
+            // print_boat(boat, true);
 
-        // crane_send(&crane_beta, message);
+            boat_lane_t* boat_lane = &tower->crane_beta->boat_lane;
 
+            boat_lane_lock(boat_lane);
+            boat_deque_push_back(boat_lane->queue, boat);
+            boat_lane_unlock(boat_lane);
+            break;
+        }
+        case WAGON_EMPTY: { // wagon is empty, flag it as such and transfer the head wagons if possible
+            wagon_t* wagon = message->data.wagon;
+            // print_wagon(wagon, true);
+
+            size_t index;
+            train_t* train = train_pipeline_find(&tower->trains, wagon, &index);
+            if (train != NULL) train->wagon_empty[index] = true;
+
+            control_tower_update_trains(tower, &tower->trains);
+            break;
+        }
+        case WAGON_FULL: { // wagon is full, flag it as such and send the tail train if possible
+            wagon_t* wagon = message->data.wagon;
+            // print_wagon(wagon, true);
+
+            size_t index;
+            train_t* train = train_pipeline_find(&tower->trains, wagon, &index);
+            if (train != NULL) train->wagon_full[index] = true;
+
+            control_tower_update_trains(tower, &tower->trains);
+            break;
+        }
+        case CRANE_STUCK:
+            // Handled by the dispatcher, once the message is accounted for
+            break;
+    }
+}
+
+/// Lets the vehicles in and handles the messages of `dispatcher`, until the platform is stuck
+void* dispatcher_entry(void* data) {
+    dispatcher_t* dispatcher = (dispatcher_t*)data;
+    control_tower_t* tower = dispatcher->tower;
+
+    // A new thread inherits the CPUs of the one creating it, which is pinned with `--cpu-tower`
+    if (dispatcher->index > 0) unpin_current_thread();
+
+    while (!atomic_load(&tower->stopped)) {
+        // New vehicles change the lanes of the cranes
+        if (control_tower_arrive(dispatcher)) control_tower_progress(tower);
+
+        // The cranes may have been stuck already when the last vehicle was due, without room for it on the platform
+        if (control_tower_is_stuck(tower)) {
+            control_tower_stop(tower);
+            break;
+        }
+
+        message_t* message = control_tower_receive(dispatcher, control_tower_next_arrival(dispatcher));
+        if (message == NULL) continue; // A vehicle is due, or another dispatcher stopped the platform
+        enum message_type type = message->type;
+        if (dispatcher->index == 0) cpu_tracker_update(&tower->cpu);
+
+        // print_message(message);
+
+        control_tower_handle(tower, message);
         free_message(message);
+
+        // Handling a message may have changed the lanes of the cranes
+        if (type != CRANE_STUCK) control_tower_progress(tower);
+        control_tower_message_handled(tower);
+        stats_add_shared(&tower->stats->messages, 1);
+
+        if (control_tower_is_stuck(tower)) {
+            control_tower_stop(tower);
+        }
     }
 
+    return NULL;
+}
+
+void* control_tower_entry(void* data) {
+    control_tower_t* control_tower = (control_tower_t*)data;
+
+    train_lane_print(&control_tower->crane_beta->train_lane, true);
+
+    double now = control_tower_time(control_tower);
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        arrival_process_start(&control_tower->processes[k], now, now + control_tower->duration);
+        atomic_store(&control_tower->arrivals_over[k], arrival_process_over(&control_tower->processes[k]));
+    }
+    control_tower_progress(control_tower);
+
+    // The tower's thread runs the first dispatcher, the other ones get their own threads, which unpin themselves
+    for (size_t d = 0; d < control_tower->n_dispatchers; d++) {
+        control_tower->dispatchers[d].tower = control_tower;
+    }
+    for (size_t d = 1; d < control_tower->n_dispatchers; d++) {
+        dispatcher_t* dispatcher = &control_tower->dispatchers[d];
+        passert_eq(int, "%d", pthread_create(&dispatcher->thread, NULL, dispatcher_entry, (void*)dispatcher), 0);
+    }
+    dispatcher_entry((void*)&control_tower->dispatchers[0]);
+    for (size_t d = 1; d < control_tower->n_dispatchers; d++) {
+        passert_eq(int, "%d", pthread_join(control_tower->dispatchers[d].thread, NULL), 0);
+    }
+
+    train_pool_print(&control_tower->train_pool);
+
+    double elapsed = control_tower_time(control_tower);
+    arrival_process_print(&control_tower->processes[ARRIVAL_TRUCK], "Trucks", elapsed);
+    arrival_process_print(&control_tower->processes[ARRIVAL_BOAT], "Boats", elapsed);
+    arrival_process_print(&control_tower->processes[ARRIVAL_TRAIN], "Trains", elapsed);
+
     // print_boat(&boat, true);
     pthread_exit(NULL);
 }
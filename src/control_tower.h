@@ -3,6 +3,11 @@
 Contains functions related to the control tower.
 Particularly, it contains the functions necessary to communicate with the control tower.
 
+By default, a single dispatcher handles every message sent to the tower and lets every kind of vehicle in.
+With `--dispatchers`, the tower runs one dispatcher per lane instead, each with its own queue and thread:
+the trucks (which also receive the `CRANE_STUCK` messages), the boats and the trains. Each dispatcher only touches
+the state of its own kind of vehicle, and any of them may find that the platform is stuck and stop the others.
+
 */
 
 #ifndef CONTROL_TOWER_H
@@ -12,38 +17,139 @@ Particularly, it contains the functions necessary to communicate with the contro
 #define N_BOATS 20
 
 struct control_tower;
+struct terminal;
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include "container.h"
 #include "message.h"
 #include "boat.h"
 #include "crane.h"
+#include "cache_line.h"
+#include "affinity.h"
+#include "stats.h"
+#include "arrival_log.h"
+#include "arrival_process.h"
 
-struct control_tower {
-    message_t* message_queue;
+/// The number of dispatchers of a tower running one per lane, indexed by `enum arrival_kind`
+#define N_DISPATCHERS N_ARRIVAL_KINDS
+
+/// A message queue of the tower and the thread handling it; written by the cranes, so it gets its own cache lines
+struct dispatcher {
+    CACHE_ALIGNED message_queue_t queue;
 
     pthread_mutex_t message_mutex;
+    /// Signaled when a message is pushed into the queue, and when a message is popped from the full queue
     pthread_cond_t message_monitor;
+    pthread_cond_t room_monitor;
+
+    struct control_tower* tower;
+    size_t index;
+    pthread_t thread;
+};
+typedef struct dispatcher dispatcher_t;
+
+struct control_tower {
+    /// Only the first `n_dispatchers` are used: either one, or `N_DISPATCHERS`
+    dispatcher_t dispatchers[N_DISPATCHERS];
+    size_t n_dispatchers;
+
+    /// What the cranes do when the queue of a dispatcher is full (see `message.h`)
+    enum backpressure backpressure;
+
+    /// Termination detection, see `control_tower_is_stuck`.
+    /// `epoch` is incremented whenever an agent may have allowed another agent to make progress,
+    /// `in_flight` counts the messages that were sent but not handled yet
+    CACHE_ALIGNED atomic_size_t epoch;
+    atomic_size_t in_flight;
+    /// Whether each arrival process is over, written by the dispatcher of its kind of vehicle
+    atomic_bool arrivals_over[N_ARRIVAL_KINDS];
+    /// Set once the cranes were told to stop; the dispatchers then return
+    atomic_bool stopped;
+
+    /// Trains are only ever allocated from this pool, as at most TRAIN_PIPELINE of them may be in flight
+    CACHE_ALIGNED train_pool_t train_pool;
+
+    /// The trains in flight
+    train_pipeline_t trains;
+
+    /// The trucks of the platform, which get replaced in place once they leave
+    truck_t* trucks;
+    size_t n_trucks;
+
+    /// Owns every boat of the platform; boats are handed over to the cranes by reference
+    boat_store_t boat_store;
 
     struct crane* crane_alpha;
     struct crane* crane_beta;
 
+    /// The terminal that the tower belongs to
+    struct terminal* terminal;
+
     pthread_t thread;
+
+    /// Migrations of the tower's thread (which runs the first dispatcher), sampled once per message
+    cpu_tracker_t cpu;
+
+    /// Where the tower publishes its statistics; must be set before the tower is started
+    tower_stats_t* stats;
+
+    /// If not NULL, the arrivals are recorded to or replayed from this log; must be set before the platform is populated
+    arrival_log_t* arrivals;
+
+    /// When the trucks, boats and trains arrive (indexed by `enum arrival_kind`); must be set before the platform is populated
+    arrival_process_t processes[N_ARRIVAL_KINDS];
+    /// For how long the timed processes schedule arrivals, in seconds
+    double duration;
+
+    /// Origin of the tower's clock, see `control_tower_time`
+    double start;
+
+    /// Stack of the free slots of `trucks`, only used if the trucks arrive over time
+    size_t* free_trucks;
+    size_t n_free_trucks;
 };
 typedef struct control_tower control_tower_t;
 
-/// Creates a new control_tower, with an empty message queue
-control_tower_t new_control_tower();
+/// Creates a new control_tower, with empty message queues of `queue_capacity` messages (0 for unbounded queues);
+/// it runs a single dispatcher unless `n_dispatchers` is changed before it is started
+control_tower_t new_control_tower(size_t queue_capacity);
 
 /// Frees a control_tower instance, must be called once for each instance
 void free_control_tower(control_tower_t* control_tower);
 
-/// Safely sends a message to the tower, locking the necessary mutexes.
-/// `message` may not be accessed by the current thread after a call to this function
+/// Safely sends a message to the tower, locking the necessary mutexes; if the queue is full, applies the tower's
+/// backpressure policy. `message` may not be accessed by the current thread after a call to this function
 void control_tower_send(control_tower_t* tower, message_t* message);
 
-/// Safely reads a message from the message queue of the tower, and sleeps if there are no message available.
-message_t* control_tower_receive(control_tower_t* tower);
+/// Safely reads a message from the message queue of a dispatcher, and sleeps if there are no message available.
+/// Returns NULL if there is still no message at `deadline` (on the tower's clock, INFINITY to wait forever),
+/// or once the tower was stopped
+message_t* control_tower_receive(dispatcher_t* dispatcher, double deadline);
+
+/// Returns the time elapsed since the tower was created, in seconds
+double control_tower_time(control_tower_t* tower);
+
+/// Returns the current epoch; a crane which is stuck records the epoch it read before looking at its lanes
+size_t control_tower_epoch(control_tower_t* tower);
+
+/// Starts a new epoch, must be called after the lanes of the cranes changed outside of a message
+void control_tower_progress(control_tower_t* tower);
+
+/// Accounts for a message that was just sent to any agent; every message but CRANE_STUCK starts a new epoch
+void control_tower_message_sent(control_tower_t* tower, message_t* message);
+
+/// Must be called by any agent once it is done handling a message
+void control_tower_message_handled(control_tower_t* tower);
+
+/// Returns true if no agent can make progress anymore: both cranes found themselves stuck during the current epoch,
+/// no message is in flight and no more vehicle is scheduled to arrive.
+/// Only the dispatchers may call this function, after they handled their message
+bool control_tower_is_stuck(control_tower_t* tower);
+
+/// Creates the initial trucks, boats and trains of the platform; the vehicles that arrive over time aren't created upfront.
+/// Must be called before the agents are started (or a snapshot must be restored instead, see `snapshot.h`)
+void control_tower_populate(control_tower_t* tower);
 
 void* control_tower_entry(void* data);
 
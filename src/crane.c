@@ -1,10 +1,15 @@
 #include "crane.h"
 #include "assert.h"
+#include "shared_memory.h"
 #include <unistd.h>
 
+/// The number of deferred messages that a crane has room for initially, enough for a pass over a full train lane
+#define CRANE_DEFERRED_CAPACITY (LANE_WAGONS * (WAGON_CONTAINERS + 1) + 1)
+
 crane_t new_crane(bool load_boats, bool load_trains) {
     crane_t res;
-    res.message_queue = NULL;
+    res.queue = new_message_queue(0);
+    res.stats = NULL;
 
     res.load_boats = load_boats;
     res.load_trains = load_trains;
@@ -13,24 +18,51 @@ crane_t new_crane(bool load_boats, bool load_trains) {
     passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
     passert_eq(int, "%d", pthread_mutexattr_setpshared(&attributes, 1), 0);
     passert_eq(int, "%d", pthread_mutex_init(&res.message_mutex, &attributes), 0);
-    passert_eq(int, "%d", pthread_mutex_init(&res.stuck_mutex, &attributes), 0);
     passert_eq(int, "%d", pthread_mutexattr_destroy(&attributes), 0);
 
     res.boat_lane = new_boat_lane();
     res.train_lane = new_train_lane();
     res.truck_lane = new_truck_lane();
 
-    res.stuck = false;
+    atomic_init(&res.stuck_epoch, 0);
     res.boats_cycled = 0;
+    res.moves = 0;
+    res.cpu = new_cpu_tracker();
+
+    for (size_t n = 0; n < TRANSFER_CHANNEL_CAPACITY; n++) {
+        res.inbound[n] = new_container_holder(true, 0);
+    }
+    res.transfers_sent = 0;
+    res.transfers_unloaded = 0;
+
+    res.record_moves = false;
+    res.ledger = new_ledger(0, load_boats ? 1 : 0);
+
+    res.yard = new_yard(0);
+
+    res.timed = false;
+    res.timing = new_crane_timing();
+
+    res.routing = ROUTING_FIXED;
+    res.routing_seed = rand();
+
+    res.train_plan.n_wagons = 0;
+    res.train_planning = false;
+    res.train_plan_changed = false;
+    res.deferred = (crane_notification_t*)shared_malloc(CRANE_DEFERRED_CAPACITY * sizeof(crane_notification_t));
+    res.n_deferred = 0;
+    res.deferred_capacity = CRANE_DEFERRED_CAPACITY;
 
     return res;
 }
 
 void free_crane(crane_t* crane) {
-    free_message(crane->message_queue);
+    free_message_queue(&crane->queue);
     free_boat_lane(&crane->boat_lane);
     free_train_lane(&crane->train_lane);
     free_truck_lane(&crane->truck_lane);
+    free_ledger(&crane->ledger);
+    shared_free(crane->deferred);
 
     pthread_mutex_destroy(&crane->message_mutex);
 }
@@ -47,20 +79,47 @@ void print_crane(crane_t* crane) {
     printf("=== ~ ===\n");
 }
 
+/// Counts the move of the container of `holder` (which may have been emptied by the move already) from the slot
+/// `from_slot` of `from` to the slot `to_slot` of `to`, see `timing_slot`
+void crane_count_move(
+    crane_t* crane,
+    const container_holder_t* holder,
+    enum container_place from,
+    size_t from_slot,
+    enum container_place to,
+    size_t to_slot
+) {
+    if (crane->moves == 0) clock_gettime(CLOCK_MONOTONIC, &crane->started);
+    crane->moves++;
+    stats_set(&crane->stats->moves, crane->moves);
+
+    if (crane->timed) {
+        crane_timing_move(&crane->timing, timing_slot(from, from_slot), timing_slot(to, to_slot));
+    }
+
+    if (crane->record_moves) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t time = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+        ledger_append(&crane->ledger, container_ulid(&holder->container), from, to, time);
+    }
+}
+
+double crane_elapsed(crane_t* crane) {
+    if (crane->moves == 0) return 0.0;
+    return (double)(crane->stopped.tv_sec - crane->started.tv_sec)
+        + (double)(crane->stopped.tv_nsec - crane->started.tv_nsec) / 1e9;
+}
+
 void crane_send(crane_t* crane, message_t* message) {
+    // Accounted for before the crane can see it, as the crane may handle and free it as soon as it is in the queue
+    control_tower_message_sent(crane->control_tower, message);
+
     // S(τ).P()
     passert_eq(int, "%d", pthread_mutex_lock(&crane->message_mutex), 0);
 
     // Q(τ).send(message)
-    message_t* current_message = crane->message_queue;
-    if (current_message == NULL) {
-        crane->message_queue = message;
-    } else {
-        while (current_message->next != NULL) {
-            current_message = current_message->next;
-        }
-        current_message->next = message;
-    }
+    message_queue_push(&crane->queue, message, &crane->stats->queue);
 
     // S(τ).V()
     passert_eq(int, "%d", pthread_mutex_unlock(&crane->message_mutex), 0);
@@ -70,26 +129,73 @@ message_t* crane_receive(crane_t* crane) {
     // S(τ).P()
     passert_eq(int, "%d", pthread_mutex_lock(&crane->message_mutex), 0);
 
-    if (crane->message_queue != NULL) {
-        // message = Q(τ).read()
-        message_t* res = crane->message_queue;
-        crane->message_queue = res->next;
-        res->next = NULL;
-        // S(τ).V()
-        passert_eq(int, "%d", pthread_mutex_unlock(&crane->message_mutex), 0);
-        return res;
-    } else {
-        passert_eq(int, "%d", pthread_mutex_unlock(&crane->message_mutex), 0);
-        return NULL;
+    // message = Q(τ).read()
+    message_t* res = message_queue_pop(&crane->queue, &crane->stats->queue);
+
+    // S(τ).V()
+    passert_eq(int, "%d", pthread_mutex_unlock(&crane->message_mutex), 0);
+    return res;
+}
+
+/// Copies the train lane for the rest of the batch, unless the crane did already. The crane only writes the containers
+/// of the wagons in its lane, and the control tower only moves a wagon out of the lane once the crane reported it
+/// full or empty, so the moves can be made without holding the lane: only the keys are written back into the lane,
+/// at the end of the batch
+void crane_plan_train_lane(crane_t* crane) {
+    if (!crane->train_planning) {
+        train_lane_lock(&crane->train_lane);
+        train_lane_snapshot(&crane->train_lane, &crane->train_plan);
+        stats_set(&crane->stats->wagons, crane->train_lane.n_wagons);
+        train_lane_unlock(&crane->train_lane);
+
+        crane->train_planning = true;
+        crane->train_plan_changed = false;
     }
 }
 
+/// Queues a message for the control tower, which will be sent at the end of the current batch
+void crane_defer(crane_t* crane, enum message_type type, union message_data data) {
+    if (crane->n_deferred == crane->deferred_capacity) {
+        size_t capacity = crane->deferred_capacity * 2;
+        crane_notification_t* deferred = (crane_notification_t*)shared_realloc(
+            crane->deferred,
+            capacity * sizeof(crane_notification_t)
+        );
+        passert_neq(crane_notification_t*, "%p", deferred, NULL, "Couldn't allocate %zu bytes of memory", capacity * sizeof(crane_notification_t));
+
+        crane->deferred = deferred;
+        crane->deferred_capacity = capacity;
+    }
+
+    crane->deferred[crane->n_deferred].type = type;
+    crane->deferred[crane->n_deferred].data = data;
+    crane->n_deferred++;
+}
+
+/// Ends a batch of moves: writes the keys of the wagons that the crane loaded or unloaded back into the train lane,
+/// then sends the deferred messages, so that the control tower only moves these wagons once their keys are up to date
+/// and is never waited for while a lane is locked
+void crane_batch_end(crane_t* crane) {
+    if (crane->train_planning && crane->train_plan_changed) {
+        train_lane_lock(&crane->train_lane);
+        train_lane_merge(&crane->train_lane, &crane->train_plan);
+        stats_set(&crane->stats->wagons, crane->train_lane.n_wagons);
+        train_lane_unlock(&crane->train_lane);
+    }
+    crane->train_planning = false;
+
+    for (size_t n = 0; n < crane->n_deferred; n++) {
+        control_tower_send(crane->control_tower, new_message(crane->deferred[n].type, crane->deferred[n].data));
+    }
+    crane->n_deferred = 0;
+}
+
 void crane_notify_boat(crane_t* crane, enum message_type type) {
     union message_data msg_data;
     msg_data.boat = crane->boat_lane.current_boat;
-    crane->boat_lane.has_current_boat = false;
+    crane->boat_lane.current_boat = NULL;
 
-    control_tower_send(crane->control_tower, new_message(type, msg_data));
+    crane_defer(crane, type, msg_data);
 }
 
 void crane_notify_truck(crane_t* crane, enum message_type type, truck_t* truck) {
@@ -98,64 +204,135 @@ void crane_notify_truck(crane_t* crane, enum message_type type, truck_t* truck)
 
     passert(truck_lane_remove(&crane->truck_lane, truck), "Truck isn't in the truck lane!\n");
 
-    control_tower_send(crane->control_tower, new_message(type, msg_data));
+    crane_defer(crane, type, msg_data);
 }
 
 void crane_notify_wagon(crane_t* crane, enum message_type type, wagon_t* wagon) {
     union message_data msg_data;
     msg_data.wagon = wagon;
 
-    control_tower_send(crane->control_tower, new_message(type, msg_data));
+    crane_defer(crane, type, msg_data);
 }
 
-bool crane_unload(crane_t* crane, container_holder_t* holder) {
+/// Stages the container of `holder`, which is in the slot `slot` of `from` and which no vehicle can take, in the yard
+/// of the crane; returns false if its stack is full, or if the container is in the yard already
+bool crane_stage(crane_t* crane, container_holder_t* holder, enum container_place from, size_t slot) {
+    if (from == CONTAINER_IN_YARD) return false;
+
     size_t destination = holder->container.destination;
+    if (!yard_stage(&crane->yard, holder)) return false;
 
-    if (crane->load_boats && crane->boat_lane.has_current_boat) { // Try to unload a container onto the current boat
-        boat_t* boat = &crane->boat_lane.current_boat;
+    crane_count_move(crane, holder, from, slot, CONTAINER_IN_YARD, destination);
+    return true;
+}
 
-        if (boat->destination == destination && !boat_is_full(boat)) {
-            transfer_container(
-                holder,
-                boat_first_empty(boat)
-            );
-            if (boat_is_full(boat)) {
-                crane_notify_boat(crane, BOAT_FULL);
-            }
+/// Moves the container of `holder`, which is in the slot `slot` of `from`, onto a vehicle, or stages it in the yard
+/// if no vehicle can take it; returns false if it couldn't be moved at all.
+/// Plans over a copy of the train lane if the wagons need to be looked at, and defers the messages for the vehicles
+/// that it fills: `crane_batch_end` must be called once the crane is done moving containers
+bool crane_unload(crane_t* crane, container_holder_t* holder, enum container_place from, size_t slot) {
+    size_t destination = holder->container.destination;
+
+    // Containers for the destinations served by other terminals are sent over to them
+    terminal_t* terminal = crane->control_tower->terminal;
+    if (!terminal_serves(terminal, destination)) {
+        if (terminal_transfer(terminal, holder)) {
+            crane_count_move(crane, holder, from, slot, CONTAINER_IN_TRANSFER, 0);
+            crane->transfers_sent++;
             return true;
         }
+        return crane_stage(crane, holder, from, slot);
     }
 
-    if (crane->load_trains) { // Try to unload a container onto a train
-        wagon_t* wagon;
-        train_lane_lock(&crane->train_lane);
-        if ((wagon = train_lane_accepts(&crane->train_lane, destination))) {
-            transfer_container(
-                holder,
-                wagon_first_empty(wagon)
-            );
-            train_lane_unlock(&crane->train_lane);
-
-            if (wagon_is_full(wagon)) {
-                crane_notify_wagon(crane, WAGON_FULL, wagon);
-            }
-            return true;
+    // Offer the vehicles that can take the container to the routing policy
+    routing_t routing = new_routing(crane->routing, &crane->routing_seed);
+    bool offering = true;
+
+    if (crane->load_boats && crane->boat_lane.current_boat != NULL) { // The current boat
+        boat_t* boat = crane->boat_lane.current_boat;
+
+        if (boat->destination == destination && !boat_is_full(boat)) {
+            routing_candidate_t candidate = {CONTAINER_ON_BOAT, boat, 0, boat_loaded(boat), BOAT_CONTAINERS, boat->arrived};
+            offering = routing_offer(&routing, &candidate);
+        }
+    }
+
+    train_lane_t* train_lane = &crane->train_plan;
+    if (crane->load_trains && offering) { // The wagons
+        crane_plan_train_lane(crane);
+        for (
+            size_t n = train_lane_next_accepting(train_lane, destination, 0);
+            offering && n < train_lane->n_wagons;
+            n = train_lane_next_accepting(train_lane, destination, n + 1)
+        ) {
+            wagon_t* wagon = train_lane->wagons[n];
+            routing_candidate_t candidate = {
+                CONTAINER_ON_WAGON, wagon, n, wagon_loaded(wagon), WAGON_CONTAINERS, wagon->train->arrived
+            };
+            offering = routing_offer(&routing, &candidate);
         }
-        train_lane_unlock(&crane->train_lane);
     }
 
-    // Otherwise, try to unload the container onto a truck
-    truck_t* truck = truck_lane_accepts(&crane->truck_lane, destination);
-    if (truck != NULL) {
+    truck_lane_t* truck_lane = &crane->truck_lane;
+    for ( // The trucks
+        size_t n = truck_lane_next_accepting(truck_lane, destination, 0);
+        offering && n < truck_lane->n_trucks;
+        n = truck_lane_next_accepting(truck_lane, destination, n + 1)
+    ) {
+        truck_t* truck = truck_lane->trucks[n];
+        routing_candidate_t candidate = {CONTAINER_ON_TRUCK, truck, n, truck_loaded(truck), TRUCK_CONTAINERS, truck->arrived};
+        offering = routing_offer(&routing, &candidate);
+    }
+
+    const routing_candidate_t* choice = routing_choice(&routing);
+    if (choice != NULL && choice->place == CONTAINER_ON_WAGON) {
+        wagon_t* wagon = (wagon_t*)choice->vehicle;
+        container_holder_t* target = wagon_first_empty(wagon);
         transfer_container(
             holder,
-            &truck->container
+            target
+        );
+        train_lane_refresh(train_lane, choice->index);
+        crane->train_plan_changed = true;
+        crane_count_move(
+            crane, holder, from, slot,
+            CONTAINER_ON_WAGON, choice->index * WAGON_CONTAINERS + (target - wagon->containers)
         );
 
-        crane_notify_truck(crane, TRUCK_FULL, truck);
+        if (wagon_is_full(wagon)) {
+            crane_notify_wagon(crane, WAGON_FULL, wagon);
+        }
+        return true;
+    } else if (choice == NULL) {
+        return crane_stage(crane, holder, from, slot);
+    } else if (choice->place == CONTAINER_ON_BOAT) {
+        boat_t* boat = (boat_t*)choice->vehicle;
+        container_holder_t* target = boat_first_empty(boat);
+        transfer_container(
+            holder,
+            target
+        );
+        crane_count_move(crane, holder, from, slot, CONTAINER_ON_BOAT, target - boat->containers);
+        if (boat_is_full(boat)) {
+            crane_notify_boat(crane, BOAT_FULL);
+        }
         return true;
     } else {
-        return false;
+        truck_t* truck = (truck_t*)choice->vehicle;
+        container_holder_t* target = truck_first_empty(truck);
+        transfer_container(
+            holder,
+            target
+        );
+        crane_count_move(
+            crane, holder, from, slot,
+            CONTAINER_ON_TRUCK, choice->index * TRUCK_CONTAINERS + (target - truck->containers)
+        );
+
+        if (truck_is_full(truck)) {
+            crane_notify_truck(crane, TRUCK_FULL, truck);
+        }
+        return true;
     }
 }
 
@@ -168,6 +345,8 @@ void crane_handle_message(crane_t* crane, message_t* message) {
         case CRANE_STUCK:
             // usleep(rand() % 1000000);
             // print_crane(crane);
+            // Read once here rather than after each move, which would put a clock read on the path being measured
+            clock_gettime(CLOCK_MONOTONIC, &crane->stopped);
             pthread_exit(NULL);
             break;
         default:
@@ -186,6 +365,8 @@ void* crane_entry(void* data) {
         if (msg != NULL) {
             crane_handle_message(crane, msg);
             free_message(msg);
+            control_tower_message_handled(crane->control_tower);
+            stats_add(&crane->stats->messages, 1);
         } else {
             break;
         }
@@ -195,22 +376,27 @@ void* crane_entry(void* data) {
 
     bool could_move = true;
     while (true) {
+        // Must be read before looking at the lanes, so that any change made to them afterwards is noticed
+        size_t epoch = control_tower_epoch(crane->control_tower);
+        cpu_tracker_update(&crane->cpu);
         message_t* msg = crane_receive(crane);
 
         if (msg != NULL) {
             crane_handle_message(crane, msg);
             free_message(msg);
+            control_tower_message_handled(crane->control_tower);
+            stats_add(&crane->stats->messages, 1);
         } else if (!could_move) {
             // print_crane(crane);
         }
 
         // Let a boat in
-        if (!crane->boat_lane.has_current_boat) {
+        if (crane->boat_lane.current_boat == NULL) {
             boat_lane_lock(&crane->boat_lane);
             if (boat_deque_pop_front(crane->boat_lane.queue, &crane->boat_lane.current_boat)) {
-                crane->boat_lane.has_current_boat = true;
                 // printf("A boat stops at the crane!\n");
             }
+            stats_set(&crane->stats->boats_queued, crane->boat_lane.queue->length);
             boat_lane_unlock(&crane->boat_lane);
         }
 
@@ -218,13 +404,13 @@ void* crane_entry(void* data) {
         could_move = false;
 
         // Unload from the boat lane
-        if (!crane->load_boats && crane->boat_lane.has_current_boat) {
-            boat_t* boat = &crane->boat_lane.current_boat;
+        if (!crane->load_boats && crane->boat_lane.current_boat != NULL) {
+            boat_t* boat = crane->boat_lane.current_boat;
             bool has_cargo = false;
             for (size_t n = 0; n < BOAT_CONTAINERS; n++) {
-                if (boat->containers[n].is_empty) continue;
+                if (container_holder_is_empty(&boat->containers[n])) continue;
 
-                if (crane_unload(crane, &boat->containers[n])) {
+                if (crane_unload(crane, &boat->containers[n], CONTAINER_ON_BOAT, n)) {
                     could_move = true;
                     // printf("SUCCESS!\n");
                 } else {
@@ -235,78 +421,116 @@ void* crane_entry(void* data) {
             if (!has_cargo) {
                 crane_notify_boat(crane, BOAT_EMPTY);
             }
+            crane_batch_end(crane);
         }
 
         // Unload from the train lane
         if (!crane->load_trains) {
-            train_lane_lock(&crane->train_lane);
+            crane_plan_train_lane(crane);
 
-            for (size_t n = 0; n < crane->train_lane.n_wagons; n++) {
-                wagon_t* wagon = crane->train_lane.wagons[n];
-                if (wagon_is_empty(wagon)) continue;
+            train_lane_t* lane = &crane->train_plan;
+            for (size_t n = train_lane_next_cargo(lane, 0); n < lane->n_wagons; n = train_lane_next_cargo(lane, n + 1)) {
+                wagon_t* wagon = lane->wagons[n];
 
                 for (size_t o = 0; o < WAGON_CONTAINERS; o++) {
-                    if (wagon->containers[o].is_empty) continue;
+                    if (container_holder_is_empty(&wagon->containers[o])) continue;
 
-                    if (crane_unload(crane, &wagon->containers[o])) {
+                    if (crane_unload(crane, &wagon->containers[o], CONTAINER_ON_WAGON, n * WAGON_CONTAINERS + o)) {
                         could_move = true;
                         // printf("SUCCESS!\n");
                     }
                 }
 
+                train_lane_refresh(lane, n);
+                crane->train_plan_changed = true;
                 if (wagon_is_empty(wagon)) {
                     crane_notify_wagon(crane, WAGON_EMPTY, wagon);
                 }
             }
 
-            train_lane_unlock(&crane->train_lane);
+            crane_batch_end(crane);
+        }
+
+        // Unload the containers received from the other terminals
+        if (terminal_receive(crane->control_tower->terminal, crane->inbound, TRANSFER_CHANNEL_CAPACITY) > 0) {
+            could_move = true;
+        }
+        for (size_t n = 0; n < TRANSFER_CHANNEL_CAPACITY; n++) {
+            if (container_holder_is_empty(&crane->inbound[n])) continue;
+
+            if (crane_unload(crane, &crane->inbound[n], CONTAINER_AT_CRANE, 0)) {
+                could_move = true;
+                crane->transfers_unloaded++;
+            }
+        }
+        crane_batch_end(crane);
+
+        // Load the containers staged in the yard onto the vehicles that showed up for them
+        for (size_t d = 0; d < N_DESTINATIONS; d++) {
+            container_holder_t* holder;
+            while ((holder = yard_top(&crane->yard, d)) != NULL && crane_unload(crane, holder, CONTAINER_IN_YARD, d)) {
+                yard_pop(&crane->yard, d);
+                could_move = true;
+            }
         }
+        crane_batch_end(crane);
 
         // Unload from the truck lane
-        struct truck_ll* current_truck = crane->truck_lane.trucks;
-        while (current_truck != NULL) {
-            truck_t* truck = current_truck->truck;
-            if (!truck->loading) {
-                if (crane_unload(crane, &truck->container)) {
-                    could_move = true;
-                    // printf("SUCCESS!\n");
-                    current_truck = current_truck->next;
+        for (size_t n = truck_lane_next_cargo(&crane->truck_lane, 0); n < crane->truck_lane.n_trucks;) {
+            truck_t* truck = crane->truck_lane.trucks[n];
+            container_holder_t* holder = truck_first_loaded(truck);
+            if (crane_unload(crane, holder, CONTAINER_ON_TRUCK, n * TRUCK_CONTAINERS + (holder - truck->containers))) {
+                could_move = true;
+                // printf("SUCCESS!\n");
+                // Otherwise the truck stays in the n-th spot, with more containers to unload
+                if (truck_is_empty(truck)) {
+                    // The truck is swapped out of the lane, so the n-th spot now holds another truck
                     crane_notify_truck(crane, TRUCK_EMPTY, truck);
-                    continue;
+                    n = truck_lane_next_cargo(&crane->truck_lane, n);
                 }
+            } else {
+                n = truck_lane_next_cargo(&crane->truck_lane, n + 1);
             }
-            current_truck = current_truck->next;
         }
+        crane_batch_end(crane);
 
-        if (!could_move && crane->boat_lane.has_current_boat) {
+        if (!could_move && crane->boat_lane.current_boat != NULL) {
             boat_lane_lock(&crane->boat_lane);
             boat_deque_push_back(crane->boat_lane.queue, crane->boat_lane.current_boat);
-            crane->boat_lane.has_current_boat = false;
+            crane->boat_lane.current_boat = NULL;
+            stats_set(&crane->stats->boats_queued, crane->boat_lane.queue->length);
             boat_lane_unlock(&crane->boat_lane);
             crane->boats_cycled++;
         }
 
-        if (!could_move) {
+        if (!could_move && msg == NULL) {
             boat_lane_lock(&crane->boat_lane);
-            if (crane->boats_cycled >= crane->boat_lane.queue->length) {
-                boat_lane_unlock(&crane->boat_lane);
-                // We are stuck
+            bool stuck = crane->boats_cycled >= crane->boat_lane.queue->length;
+            boat_lane_unlock(&crane->boat_lane);
+
+            // We are stuck: only notify the control tower the first time we notice it in this epoch
+            if (stuck && atomic_load(&crane->stuck_epoch) != epoch) {
+                atomic_store(&crane->stuck_epoch, epoch);
 
-                pthread_mutex_lock(&crane->stuck_mutex);
-                crane->stuck = true;
-                pthread_mutex_unlock(&crane->stuck_mutex);
                 union message_data msg_data;
                 msg_data.stuck = true;
-
                 control_tower_send(crane->control_tower, new_message(CRANE_STUCK, msg_data));
-            } else {
-                boat_lane_unlock(&crane->boat_lane);
             }
+        } else {
+            atomic_store(&crane->stuck_epoch, 0);
         }
 
         if (could_move) {
             crane->boats_cycled = 0;
         }
+
+        stats_set(&crane->stats->boats_cycled, crane->boats_cycled);
+        stats_set(&crane->stats->trucks, crane->truck_lane.n_trucks);
+        stats_set(
+            &crane->stats->lock_waits,
+            atomic_load_explicit(&crane->boat_lane.lock_waits, memory_order_relaxed)
+            + atomic_load_explicit(&crane->train_lane.lock_waits, memory_order_relaxed)
+        );
     }
 
     pthread_exit(NULL);
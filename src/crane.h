@@ -16,27 +16,93 @@ struct crane;
 #include "train.h"
 #include "truck.h"
 #include "control_tower.h"
+#include "cache_line.h"
+#include "affinity.h"
+#include "stats.h"
+#include "terminal.h"
+#include "ledger.h"
+#include "routing.h"
+#include "timing.h"
+#include "yard.h"
 #include <pthread.h>
+#include <time.h>
+#include <stdatomic.h>
 
+/// A message for the control tower, deferred until the crane is done with its lanes (see `crane_batch_end`)
+struct crane_notification {
+    enum message_type type;
+    union message_data data;
+};
+typedef struct crane_notification crane_notification_t;
+
+/// The fields are grouped by who writes them, with each group starting on its own cache line:
+/// the message queue is written by the other agents, the boat and train lanes are shared with the control tower,
+/// the stuck epoch is written by the crane and read by the control tower, and the rest is private to the crane.
 struct crane {
-    message_t* message_queue;
+    /// Unbounded, see `message.h`
+    CACHE_ALIGNED message_queue_t queue;
     pthread_mutex_t message_mutex;
 
-    boat_lane_t boat_lane;
-    bool load_boats;
+    CACHE_ALIGNED boat_lane_t boat_lane;
 
-    train_lane_t train_lane;
-    bool load_trains;
+    CACHE_ALIGNED train_lane_t train_lane;
+
+    /// The epoch (see `control_tower_is_stuck`) at which the crane last found itself unable to move anything,
+    /// or zero if the crane is active
+    CACHE_ALIGNED atomic_size_t stuck_epoch;
 
-    truck_lane_t truck_lane;
+    CACHE_ALIGNED truck_lane_t truck_lane;
+
+    bool load_boats;
+    bool load_trains;
 
     struct control_tower* control_tower;
 
     pthread_t thread;
 
     size_t boats_cycled;
-    bool stuck;
-    pthread_mutex_t stuck_mutex;
+
+    /// The number of containers moved by the crane, the time of its first move, and the time at which it stopped
+    size_t moves;
+    struct timespec started;
+    struct timespec stopped;
+
+    /// Migrations of the crane's thread, sampled once per iteration
+    cpu_tracker_t cpu;
+
+    /// Where the crane publishes its statistics; must be set before the crane is started
+    crane_stats_t* stats;
+
+    /// Containers received from the other terminals (see `terminal.h`) that the crane didn't unload yet
+    container_holder_t inbound[TRANSFER_CHANNEL_CAPACITY];
+    /// The number of containers sent to other terminals, and of containers received from them that the crane unloaded
+    size_t transfers_sent;
+    size_t transfers_unloaded;
+
+    /// Whether the moves of the crane are appended to its ledger (see `ledger.h`)
+    bool record_moves;
+    ledger_t ledger;
+
+    /// Where the crane stages the containers that no vehicle can take (see `yard.h`)
+    yard_t yard;
+
+    /// Whether the moves of the crane advance its simulated clock (see `timing.h`)
+    bool timed;
+    crane_timing_t timing;
+
+    /// Decides onto which vehicle each container is unloaded (see `routing.h`)
+    enum routing_policy routing;
+    unsigned int routing_seed;
+
+    /// The copy of its train lane over which the crane plans its moves onto or off the wagons during the current batch
+    /// (see `crane_plan_train_lane`), whether it was taken and whether any of its keys changed since,
+    /// and the messages for the control tower that will be sent once the keys are written back into the lane
+    train_lane_t train_plan;
+    bool train_planning;
+    bool train_plan_changed;
+    crane_notification_t* deferred;
+    size_t n_deferred;
+    size_t deferred_capacity;
 };
 typedef struct crane crane_t;
 
@@ -56,6 +122,9 @@ void crane_send(crane_t* crane, message_t* message);
 /// Otherwise, returns NULL
 message_t* crane_receive(crane_t* crane);
 
+/// Returns the number of seconds between the first move of the crane and the moment it stopped
+double crane_elapsed(crane_t* crane);
+
 void* crane_entry(void* data);
 
 #endif // CRANE_H
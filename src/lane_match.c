@@ -0,0 +1,66 @@
+#include "lane_match.h"
+
+#ifdef LANE_MATCH_X86
+#include <immintrin.h>
+#endif
+
+size_t lane_match_next_scalar(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value) {
+    for (size_t i = from; i < n; i++) {
+        if ((keys[i] & mask) == value) return i;
+    }
+    return n;
+}
+
+#ifdef LANE_MATCH_X86
+
+// The keys past `n` are padding, so a chunk may be loaded whole as long as it starts before `n`;
+// the bits of the padding are then cleared from the result
+size_t lane_match_next_sse2(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value) {
+    __m128i masks = _mm_set1_epi8((char)mask);
+    __m128i values = _mm_set1_epi8((char)value);
+
+    for (size_t i = from; i < n; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(keys + i));
+        uint32_t matches = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(chunk, masks), values));
+        if (n - i < 16) matches &= (1u << (n - i)) - 1;
+        if (matches != 0) return i + __builtin_ctz(matches);
+    }
+    return n;
+}
+
+__attribute__((target("avx2")))
+size_t lane_match_next_avx2(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value) {
+    __m256i masks = _mm256_set1_epi8((char)mask);
+    __m256i values = _mm256_set1_epi8((char)value);
+
+    for (size_t i = from; i < n; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(keys + i));
+        uint32_t matches = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(chunk, masks), values));
+        if (n - i < 32) matches &= (1u << (n - i)) - 1;
+        if (matches != 0) return i + __builtin_ctz(matches);
+    }
+    return n;
+}
+
+size_t lane_match_next(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value) {
+    // Short lanes aren't worth a vector, which would mostly compare padding
+    if (from >= n || n - from <= 8) return lane_match_next_scalar(keys, from, n, mask, value);
+    if (__builtin_cpu_supports("avx2")) return lane_match_next_avx2(keys, from, n, mask, value);
+    return lane_match_next_sse2(keys, from, n, mask, value);
+}
+
+const char* lane_match_implementation() {
+    return __builtin_cpu_supports("avx2") ? "avx2" : "sse2";
+}
+
+#else
+
+size_t lane_match_next(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value) {
+    return lane_match_next_scalar(keys, from, n, mask, value);
+}
+
+const char* lane_match_implementation() {
+    return "scalar";
+}
+
+#endif
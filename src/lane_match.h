@@ -0,0 +1,70 @@
+/*! # lane_match.h
+
+Vectorized search over the slots of a lane.
+
+Each lane keeps, next to its array of vehicles, a packed array with one byte (a "key") per slot, holding the destination
+of the vehicle in that slot and whether it has room for a container and a container to unload.
+Finding a vehicle that accepts a destination, or the next vehicle with cargo, is then a single masked compare over
+16 (SSE2) or 32 (AVX2) slots at a time, instead of following a pointer per slot.
+
+The implementation is picked at runtime from the CPU's features; define `NO_SIMD` (`make DEFINES=NO_SIMD`) to always
+use the scalar one. `make bench` builds `bench_lane_match`, which compares them at large lane sizes.
+*/
+
+#ifndef LANE_MATCH_H
+#define LANE_MATCH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "container.h"
+
+typedef uint8_t lane_key_t;
+
+/// The bits of a key holding the destination of the vehicle
+#define LANE_KEY_DESTINATION 0x1f
+/// Set if the vehicle has no room for another container
+#define LANE_KEY_FULL 0x40
+/// Set if the vehicle has no container to unload
+#define LANE_KEY_EMPTY 0x80
+
+_Static_assert(N_DESTINATIONS <= LANE_KEY_DESTINATION, "Destinations don't fit in a lane key");
+
+/// The number of keys compared at once by the widest implementation; arrays of keys must have that many bytes
+/// of padding after their last slot, see `lane_keys_size`
+#define LANE_MATCH_WIDTH 32
+
+static inline lane_key_t lane_key(size_t destination, bool full, bool empty) {
+    return (lane_key_t)destination | (full ? LANE_KEY_FULL : 0) | (empty ? LANE_KEY_EMPTY : 0);
+}
+
+/// The number of bytes to allocate for the keys of a lane of `capacity` slots
+static inline size_t lane_keys_size(size_t capacity) {
+    return capacity + LANE_MATCH_WIDTH;
+}
+
+/// Returns the index of the first of the keys `from..n` such that `(key & mask) == value`, or `n` if there are none
+size_t lane_match_next(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value);
+
+/// Returns the index of the first of the slots `from..n` accepting a container for `destination`, or `n` if there are none
+static inline size_t lane_match_next_accepting(const lane_key_t* keys, size_t from, size_t n, size_t destination) {
+    return lane_match_next(keys, from, n, LANE_KEY_DESTINATION | LANE_KEY_FULL, (lane_key_t)destination);
+}
+
+/// Returns the index of a slot accepting a container for `destination`, or `n` if there are none
+static inline size_t lane_match_accepts(const lane_key_t* keys, size_t n, size_t destination) {
+    return lane_match_next_accepting(keys, 0, n, destination);
+}
+
+/// The implementations between which `lane_match_next` picks, exposed for the benchmark
+size_t lane_match_next_scalar(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value);
+#if defined(__SSE2__) && !defined(NO_SIMD)
+#define LANE_MATCH_X86
+size_t lane_match_next_sse2(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value);
+size_t lane_match_next_avx2(const lane_key_t* keys, size_t from, size_t n, lane_key_t mask, lane_key_t value);
+#endif
+
+/// Returns the name of the implementation used by `lane_match_next`
+const char* lane_match_implementation();
+
+#endif // LANE_MATCH_H
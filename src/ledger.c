@@ -0,0 +1,260 @@
+#include "ledger.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "shared_memory.h"
+#include "ulid.h"
+
+ledger_t new_ledger(size_t terminal, size_t crane) {
+    ledger_t res;
+    res.first = NULL;
+    res.last = NULL;
+    res.length = 0;
+    res.terminal = terminal;
+    res.crane = crane;
+    return res;
+}
+
+void free_ledger(ledger_t* ledger) {
+    struct ledger_block* block = ledger->first;
+    while (block != NULL) {
+        struct ledger_block* next = block->next;
+        shared_free(block);
+        block = next;
+    }
+
+    ledger->first = NULL;
+    ledger->last = NULL;
+    ledger->length = 0;
+}
+
+void ledger_append(ledger_t* ledger, const unsigned char ulid[16], enum container_place from, enum container_place to, uint64_t time) {
+    size_t offset = ledger->length % LEDGER_BLOCK_ENTRIES;
+    if (offset == 0) {
+        struct ledger_block* block = (struct ledger_block*)shared_malloc(sizeof(struct ledger_block));
+        block->next = NULL;
+        if (ledger->last == NULL) {
+            ledger->first = block;
+        } else {
+            ledger->last->next = block;
+        }
+        ledger->last = block;
+    }
+
+    ledger_entry_t* entry = &ledger->last->entries[offset];
+    entry->time = time;
+    memcpy(entry->ulid, ulid, 16);
+    entry->from = from;
+    entry->to = to;
+    entry->terminal = ledger->terminal;
+    entry->crane = ledger->crane;
+
+    ledger->length++;
+}
+
+/// Position of a merge within a ledger
+struct ledger_cursor {
+    const struct ledger_block* block;
+    size_t offset;
+    size_t remaining;
+};
+
+ledger_view_t ledger_merge(ledger_t* const* ledgers, size_t n) {
+    ledger_view_t res;
+    memset(&res, 0, sizeof(res));
+
+    struct ledger_cursor* cursors = (struct ledger_cursor*)malloc(n * sizeof(struct ledger_cursor));
+    passert_neq(struct ledger_cursor*, "%p", cursors, NULL);
+    for (size_t l = 0; l < n; l++) {
+        cursors[l].block = ledgers[l]->first;
+        cursors[l].offset = 0;
+        cursors[l].remaining = ledgers[l]->length;
+        res.length += ledgers[l]->length;
+    }
+
+    ledger_entry_t* entries = (ledger_entry_t*)malloc((res.length > 0 ? res.length : 1) * sizeof(ledger_entry_t));
+    passert_neq(ledger_entry_t*, "%p", entries, NULL);
+
+    // Each ledger is sorted already, and there are only two per terminal
+    for (size_t e = 0; e < res.length; e++) {
+        struct ledger_cursor* next = NULL;
+        for (size_t l = 0; l < n; l++) {
+            if (cursors[l].remaining == 0) continue;
+            if (next == NULL || cursors[l].block->entries[cursors[l].offset].time < next->block->entries[next->offset].time) {
+                next = &cursors[l];
+            }
+        }
+
+        entries[e] = next->block->entries[next->offset];
+        next->remaining--;
+        if (++next->offset == LEDGER_BLOCK_ENTRIES) {
+            next->block = next->block->next;
+            next->offset = 0;
+        }
+    }
+    free(cursors);
+
+    res.entries = entries;
+    return res;
+}
+
+void ledger_view_save(const ledger_view_t* view, const char* path) {
+    FILE* file = fopen(path, "wb");
+    passert_neq(FILE*, "%p", file, NULL, "Couldn't create ledger %s", path);
+
+    struct ledger_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LEDGER_MAGIC;
+    header.version = LEDGER_VERSION;
+    header.entry_size = sizeof(ledger_entry_t);
+    header.length = view->length;
+
+    passert_eq(size_t, "%zu", fwrite(&header, sizeof(header), 1, file), 1);
+    if (view->length > 0) {
+        passert_eq(size_t, "%zu", fwrite(view->entries, sizeof(ledger_entry_t), view->length, file), view->length);
+    }
+    passert_eq(int, "%d", fclose(file), 0);
+
+    printf("Ledger => %s (%zu moves)\n", path, view->length);
+}
+
+ledger_view_t ledger_view_load(const char* path) {
+    int fd = open(path, O_RDONLY);
+    passert_gte(int, "%d", fd, 0, "Couldn't open ledger %s", path);
+    struct stat info;
+    passert_eq(int, "%d", fstat(fd, &info), 0);
+    size_t size = info.st_size;
+    passert_gte(size_t, "%zu", size, sizeof(struct ledger_header), "Ledger %s is truncated", path);
+
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    passert_neq(void*, "%p", data, MAP_FAILED);
+    close(fd);
+
+    struct ledger_header header;
+    memcpy(&header, data, sizeof(header));
+    passert_eq(uint32_t, "%" PRIx32, header.magic, LEDGER_MAGIC, "%s isn't a ledger", path);
+    passert_eq(uint32_t, "%" PRIu32, header.version, LEDGER_VERSION, "Unsupported ledger version");
+    passert_eq(uint32_t, "%" PRIu32, header.entry_size, (uint32_t)sizeof(ledger_entry_t));
+    passert_eq(size_t, "%zu", size, sizeof(header) + header.length * sizeof(ledger_entry_t), "Ledger %s is truncated", path);
+
+    ledger_view_t res;
+    memset(&res, 0, sizeof(res));
+    res.entries = (const ledger_entry_t*)((const char*)data + sizeof(header));
+    res.length = header.length;
+    res.mapping = data;
+    res.mapping_size = size;
+    return res;
+}
+
+void free_ledger_view(ledger_view_t* view) {
+    if (view->mapping != NULL) {
+        munmap(view->mapping, view->mapping_size);
+    } else {
+        free((void*)view->entries);
+    }
+    free(view->by_container);
+    memset(view, 0, sizeof(ledger_view_t));
+}
+
+/// Returns the index of the first move that happened at or after `time`
+size_t ledger_view_lower_bound(const ledger_view_t* view, uint64_t time) {
+    size_t low = 0;
+    size_t high = view->length;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (view->entries[middle].time < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void ledger_view_time_range(const ledger_view_t* view, uint64_t from, uint64_t to, size_t* begin, size_t* end) {
+    *begin = ledger_view_lower_bound(view, from);
+    *end = to > from ? ledger_view_lower_bound(view, to) : *begin;
+}
+
+int ledger_entry_compare_containers(const void* left, const void* right) {
+    const ledger_entry_t* l = (const ledger_entry_t*)left;
+    const ledger_entry_t* r = (const ledger_entry_t*)right;
+
+    int res = memcmp(l->ulid, r->ulid, 16);
+    if (res != 0) return res;
+    return (l->time > r->time) - (l->time < r->time);
+}
+
+void ledger_view_sort_by_container(ledger_view_t* view) {
+    if (view->by_container != NULL) return;
+
+    view->by_container = (ledger_entry_t*)malloc((view->length > 0 ? view->length : 1) * sizeof(ledger_entry_t));
+    passert_neq(ledger_entry_t*, "%p", view->by_container, NULL);
+    memcpy(view->by_container, view->entries, view->length * sizeof(ledger_entry_t));
+    qsort(view->by_container, view->length, sizeof(ledger_entry_t), ledger_entry_compare_containers);
+}
+
+void ledger_view_container_range(const ledger_view_t* view, const unsigned char ulid[16], size_t* begin, size_t* end) {
+    passert_neq(ledger_entry_t*, "%p", view->by_container, NULL, "The ledger isn't sorted by container");
+
+    size_t low = 0;
+    size_t high = view->length;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (memcmp(view->by_container[middle].ulid, ulid, 16) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    *begin = low;
+    *end = low;
+    while (*end < view->length && memcmp(view->by_container[*end].ulid, ulid, 16) == 0) (*end)++;
+}
+
+void print_ledger_entry(const ledger_entry_t* entry, uint64_t origin) {
+    char encoded[27];
+    ulid_encode(encoded, entry->ulid);
+
+    printf(
+        "%12.6f ms  %s  %-8s => %-8s  terminal %" PRIu8 " crane %s\n",
+        (double)(entry->time - origin) / 1e6,
+        encoded,
+        container_place_name(entry->from),
+        container_place_name(entry->to),
+        entry->terminal,
+        entry->crane == 0 ? "alpha" : "beta"
+    );
+}
+
+void ledger_view_print(const ledger_view_t* view) {
+    if (view->length == 0) {
+        printf("Ledger: no moves\n");
+        return;
+    }
+
+    size_t pairs[N_CONTAINER_PLACES][N_CONTAINER_PLACES];
+    memset(pairs, 0, sizeof(pairs));
+    for (size_t n = 0; n < view->length; n++) {
+        const ledger_entry_t* entry = &view->entries[n];
+        if (entry->from < N_CONTAINER_PLACES && entry->to < N_CONTAINER_PLACES) pairs[entry->from][entry->to]++;
+    }
+
+    printf(
+        "Ledger: %zu moves over %.3f ms\n",
+        view->length,
+        (double)(view->entries[view->length - 1].time - view->entries[0].time) / 1e6
+    );
+    for (size_t from = 0; from < N_CONTAINER_PLACES; from++) {
+        for (size_t to = 0; to < N_CONTAINER_PLACES; to++) {
+            if (pairs[from][to] == 0) continue;
+            printf("  %-8s => %-8s %zu\n", container_place_name(from), container_place_name(to), pairs[from][to]);
+        }
+    }
+}
@@ -0,0 +1,117 @@
+/*! # ledger.h
+
+Append-only ledger of the moves of the containers: which container was moved, from where, to where and when.
+
+While the platform runs, each crane appends its moves to its own `ledger_t`, in fixed-size blocks that are never moved
+nor reallocated, so recording a move is a copy and never contends with the other agents.
+Once the agents stopped, the ledgers of every crane are merged into a `ledger_view_t`: a flat array of moves sorted by
+time, which can be saved to a file and mapped back (see `viewer/sy40_ledger.c`) to answer queries by time window with
+a binary search.
+
+Since ULIDs are sorted by creation time, a view can also be sorted by container: the moves of a container are then
+contiguous, and the containers appear in the order they were created.
+*/
+
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "container.h"
+#include "container_index.h"
+
+/// The number of moves per block of a ledger
+#define LEDGER_BLOCK_ENTRIES 4096
+
+#define LEDGER_MAGIC 0x5359444c
+#define LEDGER_VERSION 1
+
+/// Followed by `length` entries, sorted by time
+struct ledger_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t reserved;
+    uint64_t length;
+};
+
+struct ledger_entry {
+    /// When the move happened, in nanoseconds on CLOCK_MONOTONIC (which is shared by the agents' processes)
+    uint64_t time;
+    unsigned char ulid[16];
+    /// `enum container_place` values
+    uint8_t from;
+    uint8_t to;
+    /// Which terminal and crane (0 for α, 1 for β) moved the container
+    uint8_t terminal;
+    uint8_t crane;
+};
+typedef struct ledger_entry ledger_entry_t;
+
+struct ledger_block {
+    ledger_entry_t entries[LEDGER_BLOCK_ENTRIES];
+    struct ledger_block* next;
+};
+
+/// Written by a single crane; the blocks are allocated in shared memory in multi-process mode (see `shared_memory.h`)
+struct ledger {
+    struct ledger_block* first;
+    struct ledger_block* last;
+    size_t length;
+
+    uint8_t terminal;
+    uint8_t crane;
+};
+typedef struct ledger ledger_t;
+
+/// Creates an empty ledger, whose moves are made by the crane `crane` of the terminal `terminal`
+ledger_t new_ledger(size_t terminal, size_t crane);
+
+void free_ledger(ledger_t* ledger);
+
+/// Appends a move of the container `ulid`, which happened at `time` (see `struct ledger_entry`)
+void ledger_append(ledger_t* ledger, const unsigned char ulid[16], enum container_place from, enum container_place to, uint64_t time);
+
+/// The moves of one or several ledgers, sorted by time
+struct ledger_view {
+    const ledger_entry_t* entries;
+    size_t length;
+
+    /// The same moves, sorted by container (and then by time); NULL until `ledger_view_sort_by_container` is called
+    ledger_entry_t* by_container;
+
+    /// If the view was loaded from a file, its mapping
+    void* mapping;
+    size_t mapping_size;
+};
+typedef struct ledger_view ledger_view_t;
+
+/// Merges the moves of `n` ledgers into a new view
+ledger_view_t ledger_merge(ledger_t* const* ledgers, size_t n);
+
+/// Writes the moves of the view to `path`
+void ledger_view_save(const ledger_view_t* view, const char* path);
+
+/// Maps the moves saved to `path`
+ledger_view_t ledger_view_load(const char* path);
+
+void free_ledger_view(ledger_view_t* view);
+
+/// Returns the range of moves `[*begin, *end)` which happened between `from` (included) and `to` (excluded)
+void ledger_view_time_range(const ledger_view_t* view, uint64_t from, uint64_t to, size_t* begin, size_t* end);
+
+/// Sorts a copy of the moves by container
+void ledger_view_sort_by_container(ledger_view_t* view);
+
+/// Returns the range `[*begin, *end)` of `view->by_container` holding the moves of the container `ulid`;
+/// `ledger_view_sort_by_container` must have been called
+void ledger_view_container_range(const ledger_view_t* view, const unsigned char ulid[16], size_t* begin, size_t* end);
+
+/// Prints a move, with its time relative to `origin`
+void print_ledger_entry(const ledger_entry_t* entry, uint64_t origin);
+
+/// Prints the number of moves, the time they span and how many moves were made between each pair of places
+void ledger_view_print(const ledger_view_t* view);
+
+#endif // LEDGER_H
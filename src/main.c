@@ -4,58 +4,94 @@
 #include <sys/wait.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 #include "assert.h"
 #include "container.h"
-#include "boat.h"
-#include "control_tower.h"
-#include "crane.h"
+#include "config.h"
+#include "terminal.h"
+#include "shared_memory.h"
+#include "container_index.h"
+#include "ledger.h"
+#include "message.h"
 
-void lfork(pthread_t* res, void* (*entry)(void*), void* data);
-void wait_success(pthread_t* thread, char* name);
 
-static control_tower_t control_tower_gamma;
-static crane_t crane_alpha, crane_beta;
+int main(int argc, char* argv[]) {
+    config_t config = parse_config(argc, argv);
 
+    srand(time(0));
+    if (config.processes) {
+        shared_memory_init(SHARED_MEMORY_SIZE);
+    }
+    container_ulids_init();
+    container_index_init();
+    message_pool_init();
 
-int main(int argc, char* argv[]) {
-    control_tower_gamma = new_control_tower();
-    crane_alpha = new_crane(false, true);
-    crane_beta = new_crane(true, false);
-
-    crane_alpha.control_tower = &control_tower_gamma;
-    crane_beta.control_tower = &control_tower_gamma;
-    control_tower_gamma.crane_alpha = &crane_alpha;
-    control_tower_gamma.crane_beta = &crane_beta;
-
-    boat_deque_push_back(crane_alpha.boat_lane.queue, new_boat(1, 5));
-    truck_t truck = empty_truck(2);
-    truck_lane_push(&crane_alpha.truck_lane, &truck);
-
-    lfork(&crane_alpha.thread, crane_entry, (void*)&crane_alpha);
-    usleep(50000);
-    lfork(&crane_beta.thread, crane_entry, (void*)&crane_beta);
-    lfork(&control_tower_gamma.thread, control_tower_entry, (void*)&control_tower_gamma);
-
-    wait_success(&crane_alpha.thread, "crane_alpha");
-    wait_success(&crane_beta.thread, "crane_beta");
-    wait_success(&control_tower_gamma.thread, "control_tower");
-
-    free_control_tower(&control_tower_gamma);
-    free_crane(&crane_alpha);
-    free_crane(&crane_beta);
-}
+    terminal_t* terminals = (terminal_t*)shared_malloc(config.n_terminals * sizeof(terminal_t));
+    for (size_t n = 0; n < config.n_terminals; n++) {
+        init_terminal(&terminals[n], n, terminals, config.n_terminals, &config);
+    }
+    // The terminals got their own copies of the arrival processes
+    free_arrival_process(&config.trucks);
+    free_arrival_process(&config.boats);
+    free_arrival_process(&config.trains);
 
-void lfork(pthread_t* res, void* (*entry)(void*), void* data) {
-    pthread_attr_t attributes;
-    pthread_attr_init(&attributes);
+    for (size_t n = 0; n < config.n_terminals; n++) {
+        terminal_start(&terminals[n]);
+    }
+    for (size_t n = 0; n < config.n_terminals; n++) {
+        terminal_join(&terminals[n]);
+    }
 
-    passert_eq(int, "%d", pthread_create(res, &attributes, entry, data), 0);
-}
+    size_t moves = 0;
+    double elapsed = 0;
+    double makespan = 0;
+    for (size_t n = 0; n < config.n_terminals; n++) {
+        terminal_print(&terminals[n]);
+
+        crane_t* cranes[2] = {terminals[n].crane_alpha, terminals[n].crane_beta};
+        for (size_t c = 0; c < 2; c++) {
+            moves += cranes[c]->moves;
+            if (crane_elapsed(cranes[c]) > elapsed) elapsed = crane_elapsed(cranes[c]);
+            if (cranes[c]->timing.busy > makespan) makespan = cranes[c]->timing.busy;
+        }
+    }
+    if (config.n_terminals > 1) {
+        printf(
+            "Moves: %zu in %zu terminals in %.3f ms, %.0f moves/s\n",
+            moves,
+            config.n_terminals,
+            elapsed * 1000.0,
+            elapsed > 0 ? moves / elapsed : 0.0
+        );
+        // The terminals work side by side, so the platform is done once the slowest of them is
+        if (config.timing) printf("Timing: makespan %.1f s in %zu terminals\n", makespan, config.n_terminals);
+    }
+
+    container_index_print();
+    container_ulids_print();
+    message_pool_print();
+
+    if (config.ledger != NULL) {
+        ledger_t** ledgers = (ledger_t**)malloc(2 * config.n_terminals * sizeof(ledger_t*));
+        passert_neq(ledger_t**, "%p", ledgers, NULL);
+        for (size_t n = 0; n < config.n_terminals; n++) {
+            ledgers[2 * n] = &terminals[n].crane_alpha->ledger;
+            ledgers[2 * n + 1] = &terminals[n].crane_beta->ledger;
+        }
+
+        ledger_view_t view = ledger_merge(ledgers, 2 * config.n_terminals);
+        ledger_view_print(&view);
+        ledger_view_save(&view, config.ledger);
+        free_ledger_view(&view);
+        free(ledgers);
+    }
 
-void wait_success(pthread_t* thread, char* name) {
-    passert_eq(
-        int, "%d",
-        pthread_join(*thread, NULL), 0,
-        "Thread %s didn't terminate normally.", name
-    );
+    for (size_t n = 0; n < config.n_terminals; n++) {
+        free_terminal(&terminals[n]);
+    }
+    container_index_free();
+    container_ulids_free();
+    message_pool_free();
+    shared_memory_print();
+    shared_free(terminals);
 }
@@ -1,10 +1,202 @@
 #include "message.h"
 #include "ulid.h"
 #include "assert.h"
+#include "shared_memory.h"
+#include <string.h>
+#include <time.h>
+
+_Static_assert(N_MESSAGE_TYPES == STATS_MESSAGE_TYPES, "The statistics must have room for every type of message");
+
+/// The number of messages that an agent takes from the pool, or gives back to it, at once
+#define MESSAGE_POOL_BATCH 32
+
+/// The number of batches allocated along with the pool, so that the agents rarely need more
+#define MESSAGE_POOL_PREALLOCATED 8
+
+struct message_chunk {
+    struct message_chunk* next;
+    message_t messages[MESSAGE_POOL_BATCH];
+};
+
+/// Free messages shared by every agent, in batches of `MESSAGE_POOL_BATCH` messages
+struct message_pool {
+    pthread_mutex_t mutex;
+
+    /// Each batch is linked through the `next` field of its messages
+    message_t** batches;
+    size_t n_batches;
+    size_t capacity;
+
+    /// Every message ever allocated, freed along with the pool
+    struct message_chunk* chunks;
+    size_t n_chunks;
+
+    /// The number of batches that the agents took from or gave back to the pool
+    size_t exchanges;
+};
+
+/// The free messages of an agent, which it takes its messages from and gives the messages it received back to
+struct message_cache {
+    message_t* head;
+    size_t length;
+};
+
+/// Inherited by the agents' processes, like the shared region it lives in
+static struct message_pool* message_pool = NULL;
+static pthread_key_t message_cache_key;
+
+/// Allocates a batch of new messages. Must be called while holding the mutex of the pool
+message_t* message_pool_grow() {
+    struct message_chunk* chunk = (struct message_chunk*)shared_malloc(sizeof(struct message_chunk));
+    passert_neq(struct message_chunk*, "%p", chunk, NULL);
+    chunk->next = message_pool->chunks;
+    message_pool->chunks = chunk;
+    message_pool->n_chunks++;
+
+    // There can't be more batches than chunks
+    if (message_pool->n_chunks > message_pool->capacity) {
+        message_pool->capacity *= 2;
+        message_pool->batches = (message_t**)shared_realloc(message_pool->batches, message_pool->capacity * sizeof(message_t*));
+        passert_neq(message_t**, "%p", message_pool->batches, NULL);
+    }
+
+    for (size_t n = 0; n < MESSAGE_POOL_BATCH; n++) {
+        chunk->messages[n].next = n + 1 < MESSAGE_POOL_BATCH ? &chunk->messages[n + 1] : NULL;
+    }
+    return &chunk->messages[0];
+}
+
+/// The messages cached by an agent stay allocated in the pool's chunks when it stops, and are freed with them
+void message_cache_destroy(void* cache) {
+    free(cache);
+}
+
+/// A process forked by the main thread would otherwise share the cache of the main thread with it
+void message_cache_forget() {
+    passert_eq(int, "%d", pthread_setspecific(message_cache_key, NULL), 0);
+}
+
+void message_pool_init() {
+    passert(message_pool == NULL, "The message pool already exists");
+
+    message_pool = (struct message_pool*)shared_malloc(sizeof(struct message_pool));
+    passert_neq(struct message_pool*, "%p", message_pool, NULL);
+
+    pthread_mutexattr_t attributes;
+    passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_setpshared(&attributes, 1), 0);
+    passert_eq(int, "%d", pthread_mutex_init(&message_pool->mutex, &attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_destroy(&attributes), 0);
+
+    message_pool->capacity = MESSAGE_POOL_PREALLOCATED;
+    message_pool->batches = (message_t**)shared_malloc(message_pool->capacity * sizeof(message_t*));
+    passert_neq(message_t**, "%p", message_pool->batches, NULL);
+    message_pool->n_batches = 0;
+    message_pool->chunks = NULL;
+    message_pool->n_chunks = 0;
+    message_pool->exchanges = 0;
+    for (size_t n = 0; n < MESSAGE_POOL_PREALLOCATED; n++) {
+        message_pool->batches[message_pool->n_batches++] = message_pool_grow();
+    }
+
+    passert_eq(int, "%d", pthread_key_create(&message_cache_key, message_cache_destroy), 0);
+    passert_eq(int, "%d", pthread_atfork(NULL, NULL, message_cache_forget), 0);
+}
+
+void message_pool_free() {
+    if (message_pool == NULL) return;
+
+    free(pthread_getspecific(message_cache_key));
+    passert_eq(int, "%d", pthread_setspecific(message_cache_key, NULL), 0);
+    passert_eq(int, "%d", pthread_key_delete(message_cache_key), 0);
+
+    struct message_chunk* chunk = message_pool->chunks;
+    while (chunk != NULL) {
+        struct message_chunk* next = chunk->next;
+        shared_free(chunk);
+        chunk = next;
+    }
+    shared_free(message_pool->batches);
+    pthread_mutex_destroy(&message_pool->mutex);
+    shared_free(message_pool);
+    message_pool = NULL;
+}
+
+void message_pool_print() {
+    passert_eq(int, "%d", pthread_mutex_lock(&message_pool->mutex), 0);
+    printf(
+        "MessagePool { messages = %zu, free_batches = %zu, exchanges = %zu }\n",
+        message_pool->n_chunks * MESSAGE_POOL_BATCH,
+        message_pool->n_batches,
+        message_pool->exchanges
+    );
+    passert_eq(int, "%d", pthread_mutex_unlock(&message_pool->mutex), 0);
+}
+
+/// Returns the cache of the current agent
+struct message_cache* message_cache() {
+    struct message_cache* res = (struct message_cache*)pthread_getspecific(message_cache_key);
+
+    if (res == NULL) {
+        passert_neq(void*, "%p", res = malloc(sizeof(struct message_cache)), NULL);
+        res->head = NULL;
+        res->length = 0;
+        passert_eq(int, "%d", pthread_setspecific(message_cache_key, res), 0);
+    }
+
+    return res;
+}
+
+/// Takes a free message from the cache of the current agent, which takes a batch from the pool when it runs out
+message_t* message_take() {
+    passert_neq(struct message_pool*, "%p", message_pool, NULL, "The message pool wasn't created");
+    struct message_cache* cache = message_cache();
+
+    if (cache->head == NULL) {
+        passert_eq(int, "%d", pthread_mutex_lock(&message_pool->mutex), 0);
+        if (message_pool->n_batches > 0) {
+            cache->head = message_pool->batches[--message_pool->n_batches];
+        } else {
+            cache->head = message_pool_grow();
+        }
+        message_pool->exchanges++;
+        passert_eq(int, "%d", pthread_mutex_unlock(&message_pool->mutex), 0);
+        cache->length = MESSAGE_POOL_BATCH;
+    }
+
+    message_t* res = cache->head;
+    cache->head = res->next;
+    cache->length--;
+    return res;
+}
+
+/// Puts `message` into the cache of the current agent, which gives a batch back to the pool once it holds two
+void message_give(message_t* message) {
+    struct message_cache* cache = message_cache();
+    message->next = cache->head;
+    cache->head = message;
+    cache->length++;
+
+    if (cache->length == 2 * MESSAGE_POOL_BATCH) {
+        message_t* batch = cache->head;
+        message_t* last = batch;
+        for (size_t n = 1; n < MESSAGE_POOL_BATCH; n++) {
+            last = last->next;
+        }
+        cache->head = last->next;
+        last->next = NULL;
+        cache->length -= MESSAGE_POOL_BATCH;
+
+        passert_eq(int, "%d", pthread_mutex_lock(&message_pool->mutex), 0);
+        message_pool->batches[message_pool->n_batches++] = batch;
+        message_pool->exchanges++;
+        passert_eq(int, "%d", pthread_mutex_unlock(&message_pool->mutex), 0);
+    }
+}
 
 message_t* new_message(enum message_type type, union message_data data) {
     struct ulid_generator* generator = get_generator();
-    message_t* res = (message_t*)malloc(sizeof(message_t));
+    message_t* res = message_take();
 
     res->type = type;
     res->data = data;
@@ -21,12 +213,12 @@ void print_message(message_t* message) {
     switch (message->type) {
         case BOAT_EMPTY:
             printf("Message { type = BOAT_EMPTY, data =\n  ");
-            print_boat(&message->data.boat, false);
+            print_boat(message->data.boat, false);
             printf("}\n");
             break;
         case BOAT_FULL:
             printf("Message { type = BOAT_FULL, data =\n  ");
-            print_boat(&message->data.boat, false);
+            print_boat(message->data.boat, false);
             printf("}\n");
             break;
 
@@ -68,6 +260,114 @@ void free_message(message_t* message) {
     while (current != NULL) {
         message_t* msg = current;
         current = msg->next;
-        free(message);
+        message_give(msg);
+    }
+}
+
+static const char* BACKPRESSURE_NAMES[N_BACKPRESSURES] = {
+    "block",
+    "spin",
+    "shed",
+};
+
+const char* backpressure_name(enum backpressure policy) {
+    return policy < N_BACKPRESSURES ? BACKPRESSURE_NAMES[policy] : "unknown";
+}
+
+bool parse_backpressure(const char* name, enum backpressure* res) {
+    for (size_t n = 0; n < N_BACKPRESSURES; n++) {
+        if (strcmp(name, BACKPRESSURE_NAMES[n]) == 0) {
+            *res = (enum backpressure)n;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Returns the time on the monotonic clock, in nanoseconds
+uint64_t message_clock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+enum message_priority message_priority(enum message_type type) {
+    switch (type) {
+        case CRANE_STUCK:
+            return MESSAGE_PRIORITY_CONTROL;
+        case BOAT_EMPTY:
+        case BOAT_FULL:
+        case TRUCK_FULL:
+        case TRUCK_EMPTY:
+            return MESSAGE_PRIORITY_RELEASE;
+        case TRUCK_NEW:
+        case WAGON_FULL:
+        case WAGON_EMPTY:
+            return MESSAGE_PRIORITY_BULK;
+    }
+    return MESSAGE_PRIORITY_BULK;
+}
+
+message_queue_t new_message_queue(size_t capacity) {
+    message_queue_t res;
+    for (size_t p = 0; p < N_MESSAGE_PRIORITIES; p++) {
+        res.heads[p] = NULL;
+        res.tails[p] = NULL;
+    }
+    res.length = 0;
+    res.capacity = capacity;
+    res.prioritized = true;
+    return res;
+}
+
+void free_message_queue(message_queue_t* queue) {
+    for (size_t p = 0; p < N_MESSAGE_PRIORITIES; p++) {
+        free_message(queue->heads[p]);
+        queue->heads[p] = NULL;
+        queue->tails[p] = NULL;
     }
+    queue->length = 0;
+}
+
+bool message_queue_full(const message_queue_t* queue) {
+    return queue->capacity > 0 && queue->length >= queue->capacity;
+}
+
+void message_queue_push(message_queue_t* queue, message_t* message, queue_stats_t* stats) {
+    passert(!message_queue_full(queue), "Pushed a message into a full queue");
+
+    size_t lane = queue->prioritized ? message_priority(message->type) : 0;
+    message->next = NULL;
+    message->queued = message_clock();
+    if (queue->tails[lane] == NULL) {
+        queue->heads[lane] = message;
+    } else {
+        queue->tails[lane]->next = message;
+    }
+    queue->tails[lane] = message;
+    queue->length++;
+
+    stats_add_shared(&stats->depth, 1);
+    stats_max_shared(&stats->high_water, queue->length);
+}
+
+message_t* message_queue_pop(message_queue_t* queue, queue_stats_t* stats) {
+    if (queue->length == 0) return NULL;
+
+    size_t lane = 0;
+    while (queue->heads[lane] == NULL) lane++;
+
+    message_t* res = queue->heads[lane];
+    queue->heads[lane] = res->next;
+    if (queue->heads[lane] == NULL) queue->tails[lane] = NULL;
+    res->next = NULL;
+    queue->length--;
+
+    uint64_t wait = message_clock() - res->queued;
+    stats_sub_shared(&stats->depth, 1);
+    stats_add(&stats->received[res->type], 1);
+    stats_add(&stats->wait[res->type], wait);
+    if (wait > stats_get(&stats->max_wait[res->type])) stats_set(&stats->max_wait[res->type], wait);
+
+    return res;
 }
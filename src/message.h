@@ -1,6 +1,30 @@
 /*! # message.h
 
 Common class for `control_tower.h` and `crane.h`, which handles the messages.
+
+Messages wait in bounded queues (see `message_queue_t`), split into one FIFO lane per priority (see `message_priority`):
+- control messages (`CRANE_STUCK`, which also tells the cranes to stop) are handled first, so that shutting down doesn't
+  wait for a backlog
+- then the messages releasing a vehicle (`TRUCK_*` and `BOAT_*`), which trucks and boats wait for before they can leave
+  or move on to the other crane
+- then the bookkeeping of the trains (`WAGON_*`) and the new trucks (`TRUCK_NEW`)
+
+With `--fifo-queues`, all messages share a single lane and are handled in the order they were sent.
+
+When the queue of the control tower is full,
+its sender applies a backpressure policy (`--backpressure`):
+- `block` (the default), the sender sleeps until the tower makes room
+- `spin`, the sender retries, yielding its CPU between attempts
+- `shed`, the messages that aren't critical are dropped (only `CRANE_STUCK`, which is sent again once the messages
+  in the queue are handled), and the other ones block
+
+The queues of the cranes are never full: the tower may not wait for a crane, which may itself be waiting for the tower,
+and a crane's queue never holds more than one message per truck, besides the `CRANE_STUCK` telling it to stop.
+
+Messages are recycled through a pool rather than allocated one by one, the same way whether the agents are threads or
+processes: each agent takes the messages it sends from its own cache of free messages, and puts the messages it handled
+back into it, without any lock. Caches only take a batch of messages from the pool, or give one back to it, under the
+pool's (process-shared) mutex once they run out or hold two batches.
 */
 
 #ifndef MESSAGE_H
@@ -9,7 +33,9 @@ Common class for `control_tower.h` and `crane.h`, which handles the messages.
 #include "boat.h"
 #include "truck.h"
 #include "train.h"
+#include "stats.h"
 #include <pthread.h>
+#include <inttypes.h>
 
 enum message_type {
     BOAT_EMPTY,
@@ -21,9 +47,10 @@ enum message_type {
     WAGON_EMPTY,
     CRANE_STUCK
 };
+#define N_MESSAGE_TYPES (CRANE_STUCK + 1)
 
 union message_data {
-    boat_t boat;
+    boat_t* boat;
     truck_t* truck;
     wagon_t* wagon; // NOTE: this value of wagon may not be dereferenced
     bool stuck;
@@ -37,9 +64,22 @@ struct message {
     unsigned char ulid[16];
 
     pthread_t sender;
+
+    /// When the message was pushed into its queue, in nanoseconds on the monotonic clock
+    uint64_t queued;
 };
 typedef struct message message_t;
 
+/// Creates the pool of messages, with a few batches of free messages.
+/// In multi-process mode, must be called after `shared_memory_init` and before the agents are started
+void message_pool_init();
+
+/// Frees every message, once no agent sends messages anymore
+void message_pool_free();
+
+/// Prints how many messages were allocated, and how many batches went through the pool
+void message_pool_print();
+
 /// Creates a new message
 message_t* new_message(enum message_type type, union message_data data);
 
@@ -49,4 +89,62 @@ void print_message(message_t* message);
 /// Should be called to free the message
 void free_message(message_t* message);
 
+enum backpressure {
+    BACKPRESSURE_BLOCK,
+    BACKPRESSURE_SPIN,
+    BACKPRESSURE_SHED,
+};
+#define N_BACKPRESSURES 3
+
+/// Returns the name of `policy`, as given to `--backpressure`
+const char* backpressure_name(enum backpressure policy);
+
+/// Parses the name of a backpressure policy, returns false if there is no such policy
+bool parse_backpressure(const char* name, enum backpressure* res);
+
+enum message_priority {
+    MESSAGE_PRIORITY_CONTROL,
+    MESSAGE_PRIORITY_RELEASE,
+    MESSAGE_PRIORITY_BULK,
+};
+#define N_MESSAGE_PRIORITIES 3
+
+/// Returns the lane in which messages of the type `type` wait, the lower the sooner they are handled
+enum message_priority message_priority(enum message_type type);
+
+/// The capacity of the tower's queues, unless set with `--queue-capacity`
+#define MESSAGE_QUEUE_DEFAULT_CAPACITY 64
+
+/// Queue of messages, made of one FIFO per priority, linked through the `next` field of the messages.
+/// It isn't synchronized: its owner must hold the mutex protecting it
+struct message_queue {
+    message_t* heads[N_MESSAGE_PRIORITIES];
+    message_t* tails[N_MESSAGE_PRIORITIES];
+    /// The number of messages, over all priorities
+    size_t length;
+
+    /// The maximum length of the queue, or 0 if it is unbounded
+    size_t capacity;
+
+    /// If false, every message goes into the first lane, so that the queue is a single FIFO
+    bool prioritized;
+};
+typedef struct message_queue message_queue_t;
+
+/// Creates an empty prioritized queue, holding at most `capacity` messages (0 for an unbounded queue)
+message_queue_t new_message_queue(size_t capacity);
+
+/// Frees the messages left in the queue
+void free_message_queue(message_queue_t* queue);
+
+/// Returns true if a message may not be pushed into the queue until another one is popped
+bool message_queue_full(const message_queue_t* queue);
+
+/// Appends a message to the queue, which may not be full; updates the depth and high-water mark of `stats`
+void message_queue_push(message_queue_t* queue, message_t* message, queue_stats_t* stats);
+
+/// Removes the oldest message of the most urgent non-empty lane and returns it, or returns NULL if the queue is empty;
+/// records for how long the message waited into `stats`
+message_t* message_queue_pop(message_queue_t* queue, queue_stats_t* stats);
+
 #endif // MESSAGE_H
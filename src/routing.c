@@ -0,0 +1,76 @@
+#include "routing.h"
+#include <string.h>
+#include <math.h>
+
+static const char* ROUTING_POLICY_NAMES[N_ROUTING_POLICIES] = {
+    "fixed",
+    "fullest",
+    "departure",
+    "boat-dwell",
+    "random",
+};
+
+const char* routing_policy_name(enum routing_policy policy) {
+    return policy < N_ROUTING_POLICIES ? ROUTING_POLICY_NAMES[policy] : "unknown";
+}
+
+bool parse_routing_policy(const char* name, enum routing_policy* res) {
+    for (size_t n = 0; n < N_ROUTING_POLICIES; n++) {
+        if (strcmp(name, ROUTING_POLICY_NAMES[n]) == 0) {
+            *res = (enum routing_policy)n;
+            return true;
+        }
+    }
+    return false;
+}
+
+routing_t new_routing(enum routing_policy policy, unsigned int* seed) {
+    routing_t res;
+    res.policy = policy;
+    res.seed = seed;
+    res.n_candidates = 0;
+    res.best_score = -INFINITY;
+    return res;
+}
+
+/// Returns the score of `candidate` under `policy`; the candidate with the highest score is chosen,
+/// ties going to the candidate offered first
+double routing_score(const routing_t* routing, const routing_candidate_t* candidate) {
+    switch (routing->policy) {
+        case ROUTING_FIXED:
+            return 0.0;
+        case ROUTING_FULLEST:
+            return (double)candidate->loaded / candidate->capacity;
+        case ROUTING_DEPARTURE:
+            return -(double)(candidate->capacity - candidate->loaded);
+        case ROUTING_BOAT_DWELL:
+            return candidate->place == CONTAINER_ON_BOAT ? INFINITY : -candidate->arrived;
+        case ROUTING_RANDOM:
+            // See `routing_offer`
+            return 0.0;
+    }
+    return 0.0;
+}
+
+bool routing_offer(routing_t* routing, const routing_candidate_t* candidate) {
+    double score = routing_score(routing, candidate);
+    bool better = score > routing->best_score;
+    if (routing->policy == ROUTING_RANDOM) {
+        // Reservoir sampling: the n-th candidate replaces the previous choice with a probability of 1/n
+        better = rand_r(routing->seed) % (routing->n_candidates + 1) == 0;
+    }
+
+    if (routing->n_candidates == 0 || better) {
+        routing->best = *candidate;
+        routing->best_score = score;
+    }
+    routing->n_candidates++;
+
+    if (routing->policy == ROUTING_FIXED) return false;
+    if (routing->policy == ROUTING_BOAT_DWELL && candidate->place == CONTAINER_ON_BOAT) return false;
+    return true;
+}
+
+const routing_candidate_t* routing_choice(const routing_t* routing) {
+    return routing->n_candidates > 0 ? &routing->best : NULL;
+}
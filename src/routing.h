@@ -0,0 +1,76 @@
+/*! # routing.h
+
+Routing policies, which decide onto which vehicle a crane unloads a container (see `crane_unload`).
+
+The crane offers every vehicle that can take the container to the policy, in a fixed order: the boat at bay,
+then the accepting wagons and the accepting trucks, in the order of their lanes. The policies are:
+- `fixed` (the default), the first vehicle offered
+- `fullest`, the vehicle with the largest share of its slots loaded, so that it leaves sooner
+- `departure`, the vehicle with the fewest free slots, which is the closest to leaving the platform
+- `boat-dwell`, the boat at bay if it can take the container, so that it leaves as soon as possible;
+  otherwise the vehicle that arrived on the platform first
+- `random`, any of the vehicles, with the same probability
+
+The policy is picked with `--routing <policy>`; `results/measure-routing.sh` compares them.
+*/
+
+#ifndef ROUTING_H
+#define ROUTING_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "container_index.h"
+
+enum routing_policy {
+    ROUTING_FIXED,
+    ROUTING_FULLEST,
+    ROUTING_DEPARTURE,
+    ROUTING_BOAT_DWELL,
+    ROUTING_RANDOM,
+};
+#define N_ROUTING_POLICIES 5
+
+/// Returns the name of `policy`, as given to `--routing`
+const char* routing_policy_name(enum routing_policy policy);
+
+/// Parses the name of a policy, returns false if there is no such policy
+bool parse_routing_policy(const char* name, enum routing_policy* res);
+
+/// A vehicle that can take the container being routed
+struct routing_candidate {
+    /// `CONTAINER_ON_BOAT`, `CONTAINER_ON_WAGON` or `CONTAINER_ON_TRUCK`
+    enum container_place place;
+    /// The vehicle (`boat_t`, `wagon_t` or `truck_t`), and its index in its lane (unused for the boat at bay)
+    void* vehicle;
+    size_t index;
+
+    size_t loaded;
+    size_t capacity;
+    /// When the vehicle (or its train) arrived on the platform, in seconds on the control tower's clock
+    double arrived;
+};
+typedef struct routing_candidate routing_candidate_t;
+
+/// The choice of a policy among the candidates offered so far
+struct routing {
+    enum routing_policy policy;
+    /// Only used by the `random` policy
+    unsigned int* seed;
+
+    size_t n_candidates;
+    routing_candidate_t best;
+    double best_score;
+};
+typedef struct routing routing_t;
+
+/// Starts routing a container; `seed` must stay valid while the container is routed
+routing_t new_routing(enum routing_policy policy, unsigned int* seed);
+
+/// Offers a candidate to the policy; returns false once the policy has made its choice,
+/// in which case the remaining candidates don't need to be offered
+bool routing_offer(routing_t* routing, const routing_candidate_t* candidate);
+
+/// Returns the chosen candidate, or NULL if none were offered
+const routing_candidate_t* routing_choice(const routing_t* routing);
+
+#endif // ROUTING_H
@@ -0,0 +1,194 @@
+#include "shared_memory.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "assert.h"
+#include "cache_line.h"
+
+/// Number of block sizes, from CACHE_LINE_SIZE to CACHE_LINE_SIZE << (SHARED_CLASSES - 1) bytes
+#define SHARED_CLASSES 40
+
+/// Class of the blocks that aren't reused
+#define SHARED_NO_CLASS ((size_t)-1)
+
+/// Stored in the cache line right before each block
+struct shared_header {
+    size_t class;
+    /// The size of the block, header included
+    size_t size;
+};
+
+struct shared_free_block {
+    struct shared_free_block* next;
+};
+
+/// Lives at the start of the region
+struct shared_region {
+    pthread_mutex_t mutex;
+
+    size_t size;
+    /// Offset of the first byte that was never allocated
+    size_t used;
+
+    struct shared_free_block* free_lists[SHARED_CLASSES];
+
+    size_t in_use;
+    size_t high_water;
+};
+
+/// Inherited by the agents' processes, which see the region at the same address
+static struct shared_region* region = NULL;
+
+void shared_memory_init(size_t size) {
+    passert(region == NULL, "The shared region is already mapped");
+
+    region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    passert_neq(void*, "%p", region, MAP_FAILED, "Couldn't map %zu bytes of shared memory", size);
+
+    memset(region, 0, sizeof(struct shared_region));
+    region->size = size;
+    region->used = (sizeof(struct shared_region) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+    pthread_mutexattr_t attributes;
+    passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_setpshared(&attributes, 1), 0);
+    passert_eq(int, "%d", pthread_mutex_init(&region->mutex, &attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_destroy(&attributes), 0);
+}
+
+bool shared_memory_enabled() {
+    return region != NULL;
+}
+
+bool shared_memory_owns(const void* ptr) {
+    return region != NULL && (const char*)ptr >= (const char*)region && (const char*)ptr < (const char*)region + region->size;
+}
+
+struct shared_header* shared_header_of(void* ptr) {
+    return (struct shared_header*)((char*)ptr - CACHE_LINE_SIZE);
+}
+
+/// Takes `size` bytes from the never allocated part of the region, so that the byte at `offset` is aligned on `alignment`.
+/// Must be called while holding the mutex
+void* shared_bump(size_t size, size_t alignment, size_t offset) {
+    uintptr_t base = (uintptr_t)region;
+    uintptr_t start = base + region->used;
+    uintptr_t aligned = (start + offset + alignment - 1) / alignment * alignment - offset;
+
+    passert_lte(size_t, "%zu", aligned - base + size, region->size, "The shared region is full (%zu bytes)", region->size);
+    region->used = aligned - base + size;
+
+    return (void*)aligned;
+}
+
+void* shared_aligned_alloc(size_t alignment, size_t size) {
+    if (region == NULL) {
+        size_t rounded = (size + alignment - 1) / alignment * alignment;
+        void* res = aligned_alloc(alignment, rounded);
+        passert_neq(void*, "%p", res, NULL, "Couldn't allocate %zu bytes of memory", rounded);
+        return res;
+    }
+
+    if (alignment <= CACHE_LINE_SIZE) return shared_malloc(size);
+
+    passert_eq(int, "%d", pthread_mutex_lock(&region->mutex), 0);
+    char* block = shared_bump(CACHE_LINE_SIZE + size, alignment, CACHE_LINE_SIZE);
+    struct shared_header* header = (struct shared_header*)block;
+    header->class = SHARED_NO_CLASS;
+    header->size = CACHE_LINE_SIZE + size;
+    region->in_use += header->size;
+    if (region->in_use > region->high_water) region->high_water = region->in_use;
+    passert_eq(int, "%d", pthread_mutex_unlock(&region->mutex), 0);
+
+    return block + CACHE_LINE_SIZE;
+}
+
+void* shared_malloc(size_t size) {
+    if (region == NULL) {
+        void* res = malloc(size);
+        passert_neq(void*, "%p", res, NULL, "Couldn't allocate %zu bytes of memory", size);
+        return res;
+    }
+
+    size_t class = 0;
+    while ((size_t)CACHE_LINE_SIZE << class < CACHE_LINE_SIZE + size) class++;
+    passert_lt(size_t, "%zu", class, SHARED_CLASSES, "Can't allocate %zu bytes of shared memory", size);
+    size_t block_size = (size_t)CACHE_LINE_SIZE << class;
+
+    passert_eq(int, "%d", pthread_mutex_lock(&region->mutex), 0);
+    char* block;
+    if (region->free_lists[class] != NULL) {
+        block = (char*)region->free_lists[class];
+        region->free_lists[class] = region->free_lists[class]->next;
+    } else {
+        block = shared_bump(block_size, CACHE_LINE_SIZE, 0);
+    }
+    region->in_use += block_size;
+    if (region->in_use > region->high_water) region->high_water = region->in_use;
+    passert_eq(int, "%d", pthread_mutex_unlock(&region->mutex), 0);
+
+    struct shared_header* header = (struct shared_header*)block;
+    header->class = class;
+    header->size = block_size;
+
+    return block + CACHE_LINE_SIZE;
+}
+
+void* shared_calloc(size_t n, size_t size) {
+    void* res = shared_malloc(n * size);
+    memset(res, 0, n * size);
+    return res;
+}
+
+void* shared_realloc(void* ptr, size_t size) {
+    if (ptr == NULL) return shared_malloc(size);
+
+    if (!shared_memory_owns(ptr)) {
+        void* res = realloc(ptr, size);
+        passert_neq(void*, "%p", res, NULL, "Couldn't allocate %zu bytes of memory", size);
+        return res;
+    }
+
+    size_t capacity = shared_header_of(ptr)->size - CACHE_LINE_SIZE;
+    if (size <= capacity) return ptr;
+
+    void* res = shared_malloc(size);
+    memcpy(res, ptr, capacity);
+    shared_free(ptr);
+
+    return res;
+}
+
+void shared_free(void* ptr) {
+    if (ptr == NULL) return;
+
+    if (!shared_memory_owns(ptr)) {
+        free(ptr);
+        return;
+    }
+
+    struct shared_header* header = shared_header_of(ptr);
+
+    passert_eq(int, "%d", pthread_mutex_lock(&region->mutex), 0);
+    region->in_use -= header->size;
+    if (header->class != SHARED_NO_CLASS) {
+        struct shared_free_block* block = (struct shared_free_block*)header;
+        block->next = region->free_lists[header->class];
+        region->free_lists[header->class] = block;
+    }
+    passert_eq(int, "%d", pthread_mutex_unlock(&region->mutex), 0);
+}
+
+void shared_memory_print() {
+    if (region == NULL) return;
+
+    printf(
+        "SharedMemory { size = %zu, used = %zu, in_use = %zu, high_water = %zu }\n",
+        region->size,
+        region->used,
+        region->in_use,
+        region->high_water
+    );
+}
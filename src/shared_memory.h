@@ -0,0 +1,44 @@
+/*! # shared_memory.h
+
+Allocation of the state shared by the agents: lanes, queues, messages and vehicle stores.
+
+By default the agents are threads, and these functions simply forward to the C allocator.
+In multi-process mode (`--processes`), `shared_memory_init` first maps an anonymous shared region, which is inherited
+by the agents' processes at the same address, so that pointers to the shared state stay valid in every process;
+the functions then allocate from that region.
+
+Blocks are rounded up to a power of two (including a header of one cache line, which keeps them cache-aligned),
+and freed blocks are kept in one free list per size, protected by a process-shared mutex.
+*/
+
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/// Size of the shared region; pages are only backed once they are used.
+/// Can be overriden at compile time with `make DEFINES="SHARED_MEMORY_SIZE=..."`
+#ifndef SHARED_MEMORY_SIZE
+#define SHARED_MEMORY_SIZE ((size_t)1 << 30)
+#endif
+
+/// Maps the shared region; must be called before anything is allocated with the functions below
+void shared_memory_init(size_t size);
+
+/// Returns true if the shared region is mapped
+bool shared_memory_enabled();
+
+void* shared_malloc(size_t size);
+void* shared_calloc(size_t n, size_t size);
+void* shared_realloc(void* ptr, size_t size);
+
+/// `alignment` must be a power of two; blocks aligned on more than a cache line are never reused once freed
+void* shared_aligned_alloc(size_t alignment, size_t size);
+
+void shared_free(void* ptr);
+
+/// Prints how much of the shared region is used, if it is mapped
+void shared_memory_print();
+
+#endif // SHARED_MEMORY_H
@@ -0,0 +1,345 @@
+#include "snapshot.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+#include "container_index.h"
+
+/// Sequential reader/writer over a mapped snapshot
+struct snapshot_cursor {
+    unsigned char* data;
+    size_t offset;
+    size_t size;
+};
+
+/// Returns a pointer to the next `size` bytes of the snapshot and advances the cursor
+void* snapshot_take(struct snapshot_cursor* cursor, size_t size) {
+    passert_lte(size_t, "%zu", cursor->offset + size, cursor->size, "Snapshot is truncated");
+    void* res = cursor->data + cursor->offset;
+    cursor->offset += size;
+    return res;
+}
+
+/// Returns the number of containers in `holders`
+size_t snapshot_count_containers(const container_holder_t* holders, size_t n) {
+    size_t res = 0;
+    for (size_t h = 0; h < n; h++) {
+        if (!container_holder_is_empty(&holders[h])) res++;
+    }
+    return res;
+}
+
+/// Writes the ULIDs of the containers in `holders`
+void snapshot_put_ulids(struct snapshot_cursor* cursor, const container_holder_t* holders, size_t n) {
+    for (size_t h = 0; h < n; h++) {
+        if (container_holder_is_empty(&holders[h])) continue;
+        memcpy(snapshot_take(cursor, 16), container_ulid(&holders[h].container), 16);
+    }
+}
+
+/// Gives the containers in `holders` their ULIDs back, written by `snapshot_put_ulids`
+void snapshot_get_ulids(struct snapshot_cursor* cursor, container_holder_t* holders, size_t n) {
+    for (size_t h = 0; h < n; h++) {
+        if (container_holder_is_empty(&holders[h])) continue;
+        passert_lt(size_t, "%zu", (size_t)holders[h].container.destination, N_DESTINATIONS, "Invalid destination in snapshot");
+        holders[h].container = restore_container(holders[h].container.destination, snapshot_take(cursor, 16));
+    }
+}
+
+crane_t* snapshot_crane(control_tower_t* tower, uint8_t crane) {
+    passert_lt(int, "%d", crane, 2, "Invalid crane in snapshot");
+    return crane == 0 ? tower->crane_alpha : tower->crane_beta;
+}
+
+void snapshot_save(control_tower_t* tower, const char* path) {
+    crane_t* cranes[2] = {tower->crane_alpha, tower->crane_beta};
+
+    struct snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.boat_containers = BOAT_CONTAINERS;
+    header.wagon_containers = WAGON_CONTAINERS;
+    header.train_wagons = TRAIN_WAGONS;
+    header.train_pipeline = TRAIN_PIPELINE;
+    header.boat_size = sizeof(boat_t);
+    header.truck_size = sizeof(truck_t);
+    header.train_size = sizeof(train_t);
+
+    header.n_trucks = tower->n_trucks;
+    header.n_trains = tower->trains.length;
+    header.pipeline_head = tower->trains.head;
+    for (size_t c = 0; c < 2; c++) {
+        boat_lane_t* lane = &cranes[c]->boat_lane;
+        header.n_boats += lane->queue->length + (lane->current_boat != NULL);
+        header.n_truck_places += cranes[c]->truck_lane.n_trucks + cranes[c]->queue.length;
+        header.n_lane_wagons += cranes[c]->train_lane.n_wagons;
+
+        if (lane->current_boat != NULL) {
+            header.n_containers += snapshot_count_containers(lane->current_boat->containers, BOAT_CONTAINERS);
+        }
+        for (size_t n = 0; n < lane->queue->length; n++) {
+            header.n_containers += snapshot_count_containers(boat_deque_get(lane->queue, n)->containers, BOAT_CONTAINERS);
+        }
+    }
+    for (size_t n = 0; n < header.n_trucks; n++) {
+        header.n_containers += snapshot_count_containers(tower->trucks[n].containers, TRUCK_CONTAINERS);
+    }
+    for (size_t t = 0; t < header.n_trains; t++) {
+        train_t* train = train_pipeline_get(&tower->trains, t);
+        for (size_t n = 0; n < train->n_wagons; n++) {
+            header.n_containers += snapshot_count_containers(train->wagons[n].containers, WAGON_CONTAINERS);
+        }
+    }
+
+    size_t size = sizeof(struct snapshot_header)
+        + header.n_trucks * sizeof(truck_t)
+        + header.n_boats * sizeof(struct snapshot_boat)
+        + header.n_trains * sizeof(train_t)
+        + header.n_truck_places * sizeof(struct snapshot_truck_place)
+        + header.n_lane_wagons * sizeof(struct snapshot_wagon)
+        + header.n_containers * 16;
+
+    int fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    passert_gte(int, "%d", fd, 0, "Couldn't create snapshot %s", path);
+    passert_eq(int, "%d", ftruncate(fd, size), 0);
+    unsigned char* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    passert_neq(void*, "%p", data, MAP_FAILED);
+    close(fd);
+
+    struct snapshot_cursor cursor = {data, 0, size - header.n_containers * 16};
+    struct snapshot_cursor ulids = {data, size - header.n_containers * 16, size};
+    memcpy(snapshot_take(&cursor, sizeof(header)), &header, sizeof(header));
+    truck_t* trucks = snapshot_take(&cursor, header.n_trucks * sizeof(truck_t));
+    memcpy(trucks, tower->trucks, header.n_trucks * sizeof(truck_t));
+    // Arrival times only make sense on the clock of the current run, they are reset on load
+    for (size_t n = 0; n < header.n_trucks; n++) {
+        trucks[n].arrived = 0;
+        snapshot_put_ulids(&ulids, trucks[n].containers, TRUCK_CONTAINERS);
+    }
+
+    for (size_t c = 0; c < 2; c++) {
+        boat_lane_t* lane = &cranes[c]->boat_lane;
+        if (lane->current_boat != NULL) {
+            struct snapshot_boat* record = snapshot_take(&cursor, sizeof(struct snapshot_boat));
+            record->boat = *lane->current_boat;
+            record->boat.arrived = 0;
+            record->crane = c;
+            record->current = true;
+            snapshot_put_ulids(&ulids, record->boat.containers, BOAT_CONTAINERS);
+        }
+        for (size_t n = 0; n < lane->queue->length; n++) {
+            struct snapshot_boat* record = snapshot_take(&cursor, sizeof(struct snapshot_boat));
+            record->boat = *boat_deque_get(lane->queue, n);
+            record->boat.arrived = 0;
+            record->crane = c;
+            record->current = false;
+            snapshot_put_ulids(&ulids, record->boat.containers, BOAT_CONTAINERS);
+        }
+    }
+
+    for (size_t t = 0; t < header.n_trains; t++) {
+        train_t* record = snapshot_take(&cursor, sizeof(train_t));
+        memcpy(record, train_pipeline_get(&tower->trains, t), sizeof(train_t));
+        record->arrived = 0;
+        // The references to the train are restored on load
+        for (size_t n = 0; n < TRAIN_WAGONS; n++) {
+            record->wagons[n].train = NULL;
+        }
+        for (size_t n = 0; n < record->n_wagons; n++) {
+            snapshot_put_ulids(&ulids, record->wagons[n].containers, WAGON_CONTAINERS);
+        }
+    }
+
+    for (size_t c = 0; c < 2; c++) {
+        truck_lane_t* lane = &cranes[c]->truck_lane;
+        for (size_t n = 0; n < lane->n_trucks; n++) {
+            passert(
+                lane->trucks[n] >= tower->trucks && lane->trucks[n] < tower->trucks + tower->n_trucks,
+                "Truck doesn't belong to the control tower"
+            );
+            struct snapshot_truck_place* record = snapshot_take(&cursor, sizeof(struct snapshot_truck_place));
+            record->truck = lane->trucks[n] - tower->trucks;
+            record->crane = c;
+            record->queued = false;
+            record->message_type = 0;
+        }
+        for (size_t p = 0; p < N_MESSAGE_PRIORITIES; p++) {
+            for (message_t* message = cranes[c]->queue.heads[p]; message != NULL; message = message->next) {
+                passert(
+                    message->type == TRUCK_NEW || message->type == TRUCK_EMPTY,
+                    "Only truck messages may be waiting in the queue of a crane when taking a snapshot"
+                );
+                passert(
+                    message->data.truck >= tower->trucks && message->data.truck < tower->trucks + tower->n_trucks,
+                    "Truck doesn't belong to the control tower"
+                );
+                struct snapshot_truck_place* record = snapshot_take(&cursor, sizeof(struct snapshot_truck_place));
+                record->truck = message->data.truck - tower->trucks;
+                record->crane = c;
+                record->queued = true;
+                record->message_type = message->type;
+            }
+        }
+    }
+
+    for (size_t c = 0; c < 2; c++) {
+        train_lane_t* lane = &cranes[c]->train_lane;
+        for (size_t n = 0; n < lane->n_wagons; n++) {
+            size_t index;
+            train_t* train = train_pipeline_find(&tower->trains, lane->wagons[n], &index);
+            passert_neq(train_t*, "%p", train, NULL, "Wagon doesn't belong to any train in flight");
+
+            size_t t = 0;
+            while (train_pipeline_get(&tower->trains, t) != train) t++;
+
+            struct snapshot_wagon* record = snapshot_take(&cursor, sizeof(struct snapshot_wagon));
+            record->train = t;
+            record->wagon = index;
+            record->crane = c;
+        }
+    }
+
+    passert_eq(size_t, "%zu", cursor.offset, cursor.size);
+    passert_eq(size_t, "%zu", ulids.offset, size);
+    passert_eq(int, "%d", msync(data, size, MS_SYNC), 0);
+    munmap(data, size);
+
+    printf("Snapshot => %s (%zu bytes)\n", path, size);
+}
+
+void snapshot_load(control_tower_t* tower, const char* path) {
+    int fd = open(path, O_RDONLY);
+    passert_gte(int, "%d", fd, 0, "Couldn't open snapshot %s", path);
+    struct stat info;
+    passert_eq(int, "%d", fstat(fd, &info), 0);
+    size_t size = info.st_size;
+    passert_gte(size_t, "%zu", size, sizeof(struct snapshot_header), "Snapshot %s is truncated", path);
+
+    unsigned char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    passert_neq(void*, "%p", data, MAP_FAILED);
+    close(fd);
+
+    struct snapshot_cursor cursor = {data, 0, size};
+    struct snapshot_header header;
+    memcpy(&header, snapshot_take(&cursor, sizeof(header)), sizeof(header));
+
+    passert_eq(uint32_t, "%" PRIx32, header.magic, SNAPSHOT_MAGIC, "%s isn't a snapshot", path);
+    passert_eq(uint32_t, "%" PRIu32, header.version, SNAPSHOT_VERSION);
+    passert(
+        header.boat_containers == BOAT_CONTAINERS
+        && header.wagon_containers == WAGON_CONTAINERS
+        && header.train_wagons == TRAIN_WAGONS
+        && header.train_pipeline == TRAIN_PIPELINE
+        && header.boat_size == sizeof(boat_t)
+        && header.truck_size == sizeof(truck_t)
+        && header.train_size == sizeof(train_t),
+        "Snapshot %s was taken by a build with a different layout", path
+    );
+    passert_eq(size_t, "%zu", header.n_trucks, tower->n_trucks, "Snapshot %s has a different number of trucks", path);
+    passert_lte(uint32_t, "%" PRIu32, header.pipeline_head, header.n_trains);
+    passert_lte(size_t, "%zu", header.n_containers * 16, size - sizeof(header), "Snapshot %s is truncated", path);
+
+    // The ULIDs are read alongside the vehicles, from the end of the snapshot
+    cursor.size = size - header.n_containers * 16;
+    struct snapshot_cursor ulids = {data, cursor.size, size};
+
+    memcpy(tower->trucks, snapshot_take(&cursor, header.n_trucks * sizeof(truck_t)), header.n_trucks * sizeof(truck_t));
+    for (size_t n = 0; n < header.n_trucks; n++) {
+        snapshot_get_ulids(&ulids, tower->trucks[n].containers, TRUCK_CONTAINERS);
+    }
+
+    // The restored vehicles arrive now
+    double now = control_tower_time(tower);
+
+    for (size_t n = 0; n < header.n_boats; n++) {
+        struct snapshot_boat* record = snapshot_take(&cursor, sizeof(struct snapshot_boat));
+        boat_lane_t* lane = &snapshot_crane(tower, record->crane)->boat_lane;
+
+        boat_t* boat = boat_store_alloc(&tower->boat_store);
+        *boat = record->boat;
+        boat->arrived = now;
+        snapshot_get_ulids(&ulids, boat->containers, BOAT_CONTAINERS);
+        container_index_place_all(boat->containers, BOAT_CONTAINERS);
+        arrival_process_arrived(&tower->processes[ARRIVAL_BOAT], now);
+
+        if (record->current) {
+            passert_eq(boat_t*, "%p", lane->current_boat, NULL, "Two boats stationned at the same crane");
+            lane->current_boat = boat;
+        } else {
+            boat_deque_push_back(lane->queue, boat);
+        }
+    }
+
+    train_t* trains[TRAIN_PIPELINE];
+    for (size_t t = 0; t < header.n_trains; t++) {
+        train_t* train = train_pool_alloc(&tower->train_pool);
+        memcpy(train, snapshot_take(&cursor, sizeof(train_t)), sizeof(train_t));
+        for (size_t n = 0; n < TRAIN_WAGONS; n++) {
+            train->wagons[n].train = train;
+        }
+        passert_lte(size_t, "%zu", train->n_wagons, TRAIN_WAGONS, "Invalid train in snapshot");
+        for (size_t n = 0; n < train->n_wagons; n++) {
+            snapshot_get_ulids(&ulids, train->wagons[n].containers, WAGON_CONTAINERS);
+            container_index_place_all(train->wagons[n].containers, WAGON_CONTAINERS);
+        }
+        // The wagons past the end of the train are stale, and their containers don't exist in this run
+        for (size_t n = train->n_wagons; n < TRAIN_WAGONS; n++) {
+            for (size_t c = 0; c < WAGON_CONTAINERS; c++) {
+                train->wagons[n].containers[c] = new_container_holder(true, 0);
+            }
+        }
+        train->arrived = now;
+        arrival_process_arrived(&tower->processes[ARRIVAL_TRAIN], now);
+
+        train_pipeline_push(&tower->trains, train);
+        trains[t] = train;
+    }
+    tower->trains.head = header.pipeline_head;
+
+    bool* placed = (bool*)calloc(header.n_trucks, sizeof(bool));
+    passert_neq(bool*, "%p", placed, NULL);
+
+    for (size_t n = 0; n < header.n_truck_places; n++) {
+        struct snapshot_truck_place* record = snapshot_take(&cursor, sizeof(struct snapshot_truck_place));
+        crane_t* crane = snapshot_crane(tower, record->crane);
+        passert_lt(uint32_t, "%" PRIu32, record->truck, header.n_trucks);
+        truck_t* truck = &tower->trucks[record->truck];
+        passert(!placed[record->truck], "Truck %" PRIu32 " is in two places", record->truck);
+        placed[record->truck] = true;
+        truck->arrived = now;
+        container_index_place_all(truck->containers, TRUCK_CONTAINERS);
+        arrival_process_arrived(&tower->processes[ARRIVAL_TRUCK], now);
+
+        if (record->queued) {
+            union message_data msg_data;
+            msg_data.truck = truck;
+            crane_send(crane, new_message(record->message_type, msg_data));
+        } else {
+            truck_lane_push(&crane->truck_lane, truck);
+        }
+    }
+
+    // The slots of the trucks that aren't on the platform are free for the trucks arriving over time
+    if (arrival_process_timed(&tower->processes[ARRIVAL_TRUCK])) {
+        for (size_t n = header.n_trucks; n > 0; n--) {
+            if (!placed[n - 1]) tower->free_trucks[tower->n_free_trucks++] = n - 1;
+        }
+    }
+    free(placed);
+
+    for (size_t n = 0; n < header.n_lane_wagons; n++) {
+        struct snapshot_wagon* record = snapshot_take(&cursor, sizeof(struct snapshot_wagon));
+        passert_lt(uint32_t, "%" PRIu32, (uint32_t)record->train, header.n_trains);
+        passert_lt(size_t, "%zu", (size_t)record->wagon, trains[record->train]->n_wagons);
+
+        train_lane_append(&snapshot_crane(tower, record->crane)->train_lane, &trains[record->train]->wagons[record->wagon]);
+    }
+    passert_eq(size_t, "%zu", ulids.offset, size);
+
+    munmap(data, size);
+
+    printf("Snapshot <= %s (%zu bytes)\n", path, size);
+}
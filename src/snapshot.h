@@ -0,0 +1,75 @@
+/*! # snapshot.h
+
+Checkpoint and restore of the state of the platform: the trucks, the boats, the trains in flight, the lanes and the messages
+waiting in the queues of the cranes are written into a compact, memory-mapped file, which can then be restored
+instead of populating the platform with `control_tower_populate`.
+
+Snapshots may only be taken and restored while the agents aren't running; the file records the layout of the structures,
+so a snapshot can only be restored by a build with the same layout.
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <inttypes.h>
+#include "control_tower.h"
+
+#define SNAPSHOT_MAGIC 0x53594e50
+#define SNAPSHOT_VERSION 2
+
+struct snapshot_header {
+    uint32_t magic;
+    uint32_t version;
+
+    /// Layout of the platform, which must match the one of the build restoring the snapshot
+    uint32_t boat_containers;
+    uint32_t wagon_containers;
+    uint32_t train_wagons;
+    uint32_t train_pipeline;
+    uint32_t boat_size;
+    uint32_t truck_size;
+    uint32_t train_size;
+
+    uint32_t n_trucks;
+    uint32_t n_boats;
+    uint32_t n_trains;
+    uint32_t pipeline_head;
+    uint32_t n_truck_places;
+    uint32_t n_lane_wagons;
+    uint32_t n_containers;
+};
+
+/// Followed by the trucks (`truck_t`, in the order of the tower's `trucks`), the boats, the trains (`train_t`, from the tail
+/// of the pipeline), the places of the trucks, the wagons in the train lanes and the ULIDs of the containers, in that order.
+/// Containers only hold the index of their ULID in the table of the run (see `container.h`), so the ULIDs are saved
+/// separately, in the order of the containers in the trucks, boats and wagons, and the containers get new indices on load
+struct snapshot_boat {
+    boat_t boat;
+    /// 0 for crane α, 1 for crane β
+    uint8_t crane;
+    /// Whether the boat is stationned at the crane, rather than waiting in its queue
+    uint8_t current;
+};
+
+/// A truck is either parked in the truck lane of a crane, or is in a message that the crane hasn't read yet
+struct snapshot_truck_place {
+    uint32_t truck;
+    uint8_t crane;
+    uint8_t queued;
+    /// The type of the message, if `queued` is set
+    uint8_t message_type;
+};
+
+struct snapshot_wagon {
+    uint16_t train;
+    uint8_t wagon;
+    uint8_t crane;
+};
+
+/// Writes the state of the platform into the file at `path`
+void snapshot_save(control_tower_t* tower, const char* path);
+
+/// Restores the state of the platform from the file at `path`; the tower and the cranes must be freshly created
+void snapshot_load(control_tower_t* tower, const char* path);
+
+#endif // SNAPSHOT_H
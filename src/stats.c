@@ -0,0 +1,165 @@
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "assert.h"
+
+platform_stats_t* stats_create(const char* name) {
+    platform_stats_t* res = MAP_FAILED;
+
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (ftruncate(fd, sizeof(platform_stats_t)) == 0) {
+            res = mmap(NULL, sizeof(platform_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+    }
+
+    if (res == MAP_FAILED) {
+        fprintf(stderr, FMT_WARN("WARN") ": couldn't create the statistics segment %s, statistics won't be visible\n", name);
+        res = mmap(NULL, sizeof(platform_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        passert_neq(void*, "%p", res, MAP_FAILED);
+    }
+
+    // Freshly mapped memory is zeroed, which is a valid initial state for every counter
+    res->magic = STATS_MAGIC;
+    res->version = STATS_VERSION;
+    res->pid = (int32_t)getpid();
+    passert_eq(int, "%d", sem_init(&res->locate.request, 1, 0), 0);
+    passert_eq(int, "%d", sem_init(&res->locate.answer, 1, 0), 0);
+    atomic_store(&res->running, true);
+
+    return res;
+}
+
+const platform_stats_t* stats_open(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(platform_stats_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    const platform_stats_t* res = mmap(NULL, sizeof(platform_stats_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (res == MAP_FAILED) return NULL;
+
+    if (res->magic != STATS_MAGIC || res->version != STATS_VERSION) {
+        munmap((void*)res, sizeof(platform_stats_t));
+        return NULL;
+    }
+
+    return res;
+}
+
+void stats_destroy(platform_stats_t* stats, const char* name) {
+    // The semaphores of the queries aren't destroyed: a viewer may still be waiting on them, until it sees this
+    atomic_store(&stats->running, false);
+    munmap(stats, sizeof(platform_stats_t));
+    shm_unlink(name);
+}
+
+void stats_close(const platform_stats_t* stats) {
+    munmap((void*)stats, sizeof(platform_stats_t));
+}
+
+/// Returns whether the platform publishing `stats` still runs; one that crashed leaves its segment behind
+bool stats_running(const platform_stats_t* stats) {
+    return atomic_load((atomic_bool*)&stats->running) && (kill(stats->pid, 0) == 0 || errno == EPERM);
+}
+
+bool stats_locate(const char* name, const unsigned char ulid[16], stats_location_t* location) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return false;
+
+    platform_stats_t* stats = MAP_FAILED;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(platform_stats_t)) {
+        stats = mmap(NULL, sizeof(platform_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (stats == MAP_FAILED) return false;
+
+    bool answered = false;
+    if (stats->magic == STATS_MAGIC && stats->version == STATS_VERSION) {
+        locate_query_t* query = &stats->locate;
+
+        bool asking = false;
+        while (!asking && stats_running(stats)) {
+            bool busy = false;
+            asking = atomic_compare_exchange_strong(&query->busy, &busy, true);
+            if (!asking) usleep(1000);
+        }
+
+        if (asking) {
+            memcpy(query->ulid, ulid, 16);
+            sem_post(&query->request);
+
+            // The platform answers right away while it runs, but stops answering once it stops
+            while (!answered && stats_running(stats)) {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += 100000000;
+                if (deadline.tv_nsec >= 1000000000) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000;
+                }
+                answered = sem_timedwait(&query->answer, &deadline) == 0;
+            }
+            if (answered) *location = query->location;
+
+            atomic_store(&query->busy, false);
+        }
+    }
+
+    munmap(stats, sizeof(platform_stats_t));
+    return answered;
+}
+
+static const char* STATS_MESSAGE_TYPE_NAMES[STATS_MESSAGE_TYPES] = {
+    "BOAT_EMPTY",
+    "BOAT_FULL",
+    "TRUCK_FULL",
+    "TRUCK_EMPTY",
+    "TRUCK_NEW",
+    "WAGON_FULL",
+    "WAGON_EMPTY",
+    "CRANE_STUCK",
+};
+
+const char* stats_message_type_name(size_t type) {
+    return type < STATS_MESSAGE_TYPES ? STATS_MESSAGE_TYPE_NAMES[type] : "UNKNOWN";
+}
+
+void queue_stats_print(const char* prefix, const char* name, const queue_stats_t* stats) {
+    printf(
+        "%sQueue %s: high water: %zu, waited for room: %zu, shed: %zu",
+        prefix,
+        name,
+        stats_get(&stats->high_water),
+        stats_get(&stats->waited),
+        stats_get(&stats->shed)
+    );
+
+    for (size_t type = 0; type < STATS_MESSAGE_TYPES; type++) {
+        size_t received = stats_get(&stats->received[type]);
+        if (received == 0) continue;
+
+        printf(
+            ", %s: %zu in %.3f ms avg, %.3f ms max",
+            stats_message_type_name(type),
+            received,
+            stats_get(&stats->wait[type]) / (double)received / 1e6,
+            stats_get(&stats->max_wait[type]) / 1e6
+        );
+    }
+    printf("\n");
+}
@@ -0,0 +1,175 @@
+/*! # stats.h
+
+Live statistics of the platform, published in a shared memory segment so that they can be observed
+from another process while the platform runs (see `viewer/sy40_top.c`).
+
+Every counter has a single writer (or is only written while holding the mutex that protects what it measures),
+so publishing a value is a relaxed atomic store and costs the agents nothing more. The only exceptions are the
+message counters of the control tower, whose dispatchers (see `control_tower.h`) may run on several threads,
+and the counters of the message queues that their senders write.
+
+The segment also carries track-and-trace queries the other way around: a viewer writes the ULID of a container in it
+(see `stats_locate`), and a thread of the platform answers with where the container is, from the container index.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <semaphore.h>
+#include "cache_line.h"
+
+#define STATS_DEFAULT_NAME "/sy40_stats"
+#define STATS_MAGIC 0x53593430
+#define STATS_VERSION 3
+
+/// The number of types of messages, see `enum message_type`
+#define STATS_MESSAGE_TYPES 8
+
+/// Counters of a message queue (or of all of the queues of the control tower)
+struct queue_stats {
+    /// The number of messages waiting, and the largest number of messages that waited in one queue
+    CACHE_ALIGNED atomic_size_t depth;
+    atomic_size_t high_water;
+    /// The number of messages whose sender found the queue full, and waited for room or shed the message
+    atomic_size_t waited;
+    atomic_size_t shed;
+
+    /// Indexed by `enum message_type` and written by the receiver of each type: the number of messages received,
+    /// and the total and maximum time that they spent in the queue, in nanoseconds
+    atomic_size_t received[STATS_MESSAGE_TYPES];
+    atomic_size_t wait[STATS_MESSAGE_TYPES];
+    atomic_size_t max_wait[STATS_MESSAGE_TYPES];
+};
+typedef struct queue_stats queue_stats_t;
+
+/// Counters of a crane; the lane counters are written while holding the corresponding lane's mutex
+struct crane_stats {
+    CACHE_ALIGNED atomic_size_t moves;
+    atomic_size_t messages;
+    atomic_size_t boats_cycled;
+    atomic_size_t trucks;
+    /// Number of times a lock on one of the crane's lanes had to wait, regardless of who tried to lock it
+    atomic_size_t lock_waits;
+
+    queue_stats_t queue;
+
+    /// Written while holding the crane's boat and train lane mutexes, respectively
+    CACHE_ALIGNED atomic_size_t boats_queued;
+    CACHE_ALIGNED atomic_size_t wagons;
+};
+typedef struct crane_stats crane_stats_t;
+
+/// Counters of the control tower
+struct tower_stats {
+    /// Written by every dispatcher of the tower
+    CACHE_ALIGNED atomic_size_t messages;
+    atomic_size_t trucks_departed;
+    atomic_size_t boats_departed;
+    atomic_size_t trains_departed;
+    atomic_size_t boats_in_use;
+    atomic_size_t trains_in_use;
+
+    /// The queues of all of the tower's dispatchers
+    queue_stats_t queue;
+};
+typedef struct tower_stats tower_stats_t;
+
+/// Where a container is, as answered to a track-and-trace query
+struct stats_location {
+    /// False if the container isn't on the platform
+    bool found;
+    /// The name of the place of the container, see `container_place_name`
+    char place[16];
+    /// The address of the vehicle holding the container, which tells apart the vehicles of the platform,
+    /// and the slot of the container in it
+    uint64_t vehicle;
+    uint64_t slot;
+};
+typedef struct stats_location stats_location_t;
+
+/// A track-and-trace query: the viewer asking writes `ulid` and posts `request`,
+/// the platform writes `location` and posts `answer`
+struct locate_query {
+    /// Set by the viewer asking, so that viewers ask one at a time
+    atomic_bool busy;
+    sem_t request;
+    sem_t answer;
+
+    unsigned char ulid[16];
+    stats_location_t location;
+};
+typedef struct locate_query locate_query_t;
+
+struct platform_stats {
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;
+    atomic_bool running;
+
+    crane_stats_t alpha;
+    crane_stats_t beta;
+    tower_stats_t tower;
+
+    locate_query_t locate;
+};
+typedef struct platform_stats platform_stats_t;
+
+/// Creates (or truncates) the shared memory segment `name` and maps it.
+/// If the segment cannot be created, falls back to private memory so that the agents can still publish their counters
+platform_stats_t* stats_create(const char* name);
+
+/// Maps an existing segment read-only, returns NULL if it doesn't exist (yet)
+const platform_stats_t* stats_open(const char* name);
+
+/// Marks the platform as stopped, unmaps the segment and removes its name
+void stats_destroy(platform_stats_t* stats, const char* name);
+
+/// Unmaps a segment mapped with `stats_open`
+void stats_close(const platform_stats_t* stats);
+
+/// Asks the platform publishing the segment `name` where the container `ulid` is, and waits for its answer.
+/// Returns false if no running platform answered
+bool stats_locate(const char* name, const unsigned char ulid[16], stats_location_t* location);
+
+/// Publishes a value; only the single writer of `counter` may call this
+static inline void stats_set(atomic_size_t* counter, size_t value) {
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+/// Increments a counter; only the single writer of `counter` may call this
+static inline void stats_add(atomic_size_t* counter, size_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+/// Increments or decrements a counter that several threads may write
+static inline void stats_add_shared(atomic_size_t* counter, size_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+static inline void stats_sub_shared(atomic_size_t* counter, size_t value) {
+    atomic_fetch_sub_explicit(counter, value, memory_order_relaxed);
+}
+
+/// Raises a counter that several threads may write to `value`, if it is lower
+static inline void stats_max_shared(atomic_size_t* counter, size_t value) {
+    size_t current = atomic_load_explicit(counter, memory_order_relaxed);
+    while (current < value && !atomic_compare_exchange_weak_explicit(
+        counter, &current, value, memory_order_relaxed, memory_order_relaxed
+    ));
+}
+
+/// Returns the name of the message type `type`, see `enum message_type`
+const char* stats_message_type_name(size_t type);
+
+/// Prints the counters of a queue, with the time spent in it by each type of message that went through it
+void queue_stats_print(const char* prefix, const char* name, const queue_stats_t* stats);
+
+/// Reads a counter, from any thread or process
+static inline size_t stats_get(const atomic_size_t* counter) {
+    return atomic_load_explicit((atomic_size_t*)counter, memory_order_relaxed);
+}
+
+#endif // STATS_H
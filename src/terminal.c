@@ -0,0 +1,400 @@
+#define _GNU_SOURCE
+#include "terminal.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include "assert.h"
+#include "affinity.h"
+#include "snapshot.h"
+#include "shared_memory.h"
+#include "container_index.h"
+
+void lfork(pthread_t* res, void* (*entry)(void*), void* data, int cpu);
+void wait_success(pthread_t* thread, char* name);
+void pfork(pid_t* res, void* (*entry)(void*), void* data, int cpu);
+void wait_process(pid_t pid, char* name);
+
+char* terminal_name(const char* base, size_t index) {
+    size_t length = strlen(base) + 24;
+    char* res = (char*)malloc(length);
+    passert_neq(char*, "%p", res, NULL);
+
+    if (index == 0) {
+        snprintf(res, length, "%s", base);
+    } else {
+        snprintf(res, length, "%s.%zu", base, index);
+    }
+
+    return res;
+}
+
+/// Returns the CPU of an agent of the terminal `index`: the terminals are laid out on consecutive groups of 3 CPUs
+int terminal_cpu(int cpu, size_t index) {
+    if (cpu < 0) return -1;
+
+    long n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    passert_gt(long, "%ld", n_cpus, 0);
+
+    return (int)((cpu + 3 * index) % n_cpus);
+}
+
+transfer_channel_t new_transfer_channel() {
+    transfer_channel_t res;
+    res.begin = 0;
+    res.length = 0;
+    res.received = 0;
+    res.drained = 0;
+    res.full = 0;
+    for (size_t n = 0; n < TRANSFER_CHANNEL_CAPACITY; n++) {
+        res.containers[n] = new_container_holder(true, 0);
+    }
+
+    pthread_mutexattr_t attributes;
+    passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_setpshared(&attributes, 1), 0);
+    passert_eq(int, "%d", pthread_mutex_init(&res.mutex, &attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_destroy(&attributes), 0);
+
+    return res;
+}
+
+void init_terminal(terminal_t* terminal, size_t index, terminal_t* terminals, size_t n_terminals, const config_t* config) {
+    terminal->index = index;
+    terminal->terminals = terminals;
+    terminal->n_terminals = n_terminals;
+    terminal->transfer = config->transfer;
+    terminal->channel = new_transfer_channel();
+
+    terminal->cpu_alpha = terminal_cpu(config->cpu_alpha, index);
+    terminal->cpu_beta = terminal_cpu(config->cpu_beta, index);
+    terminal->cpu_tower = terminal_cpu(config->cpu_tower, index);
+    terminal->processes = config->processes;
+
+    // Each agent is allocated on its own pages, on the NUMA node of the CPU it is pinned to (if any)
+    terminal->control_tower = (control_tower_t*)alloc_on_cpu(terminal->cpu_tower, sizeof(control_tower_t));
+    *terminal->control_tower = new_control_tower(config->queue_capacity);
+    terminal->crane_alpha = (crane_t*)alloc_on_cpu(terminal->cpu_alpha, sizeof(crane_t));
+    *terminal->crane_alpha = new_crane(false, true);
+    terminal->crane_beta = (crane_t*)alloc_on_cpu(terminal->cpu_beta, sizeof(crane_t));
+    *terminal->crane_beta = new_crane(true, false);
+    terminal->crane_alpha->record_moves = config->ledger != NULL;
+    terminal->crane_alpha->ledger = new_ledger(index, 0);
+    terminal->crane_beta->record_moves = config->ledger != NULL;
+    terminal->crane_beta->ledger = new_ledger(index, 1);
+    terminal->crane_alpha->routing = config->routing;
+    terminal->crane_beta->routing = config->routing;
+    terminal->crane_alpha->yard.height = config->yard_height;
+    terminal->crane_beta->yard.height = config->yard_height;
+    terminal->crane_alpha->timed = config->timing;
+    terminal->crane_beta->timed = config->timing;
+    terminal->control_tower->n_dispatchers = config->dispatchers ? N_DISPATCHERS : 1;
+    terminal->control_tower->backpressure = config->backpressure;
+    for (size_t d = 0; d < N_DISPATCHERS; d++) {
+        terminal->control_tower->dispatchers[d].queue.prioritized = !config->fifo_queues;
+    }
+    terminal->crane_alpha->queue.prioritized = !config->fifo_queues;
+    terminal->crane_beta->queue.prioritized = !config->fifo_queues;
+    unpin_current_thread();
+
+    container_index_register(CONTAINER_IN_TRANSFER, terminal->channel.containers, 1, sizeof(terminal->channel.containers));
+    container_index_register(CONTAINER_AT_CRANE, terminal->crane_alpha->inbound, 1, sizeof(terminal->crane_alpha->inbound));
+    container_index_register(CONTAINER_AT_CRANE, terminal->crane_beta->inbound, 1, sizeof(terminal->crane_beta->inbound));
+    container_index_register(CONTAINER_IN_YARD, terminal->crane_alpha->yard.stacks, 1, sizeof(terminal->crane_alpha->yard.stacks));
+    container_index_register(CONTAINER_IN_YARD, terminal->crane_beta->yard.stacks, 1, sizeof(terminal->crane_beta->yard.stacks));
+
+    control_tower_t* control_tower = terminal->control_tower;
+    crane_t* crane_alpha = terminal->crane_alpha;
+    crane_t* crane_beta = terminal->crane_beta;
+
+    terminal->stats_name = terminal_name(config->stats_name, index);
+    terminal->stats = stats_create(terminal->stats_name);
+    crane_alpha->stats = &terminal->stats->alpha;
+    crane_beta->stats = &terminal->stats->beta;
+    control_tower->stats = &terminal->stats->tower;
+
+    crane_alpha->control_tower = control_tower;
+    crane_beta->control_tower = control_tower;
+    control_tower->crane_alpha = crane_alpha;
+    control_tower->crane_beta = crane_beta;
+    control_tower->terminal = terminal;
+
+    // Every terminal generates its own vehicles, following its own copy of the arrival processes of the configuration
+    control_tower->processes[ARRIVAL_TRUCK] = config->trucks;
+    control_tower->processes[ARRIVAL_BOAT] = config->boats;
+    control_tower->processes[ARRIVAL_TRAIN] = config->trains;
+    for (size_t k = 0; k < N_ARRIVAL_KINDS; k++) {
+        arrival_process_t* process = &control_tower->processes[k];
+        if (process->n_trace > 0) {
+            double* trace = (double*)shared_malloc(process->n_trace * sizeof(double));
+            passert_neq(double*, "%p", trace, NULL);
+            memcpy(trace, process->trace, process->n_trace * sizeof(double));
+            process->trace = trace;
+        }
+    }
+    control_tower->duration = config->duration / 1000.0;
+
+    if (config->record_arrivals != NULL) {
+        char* path = terminal_name(config->record_arrivals, index);
+        control_tower->arrivals = arrival_log_record(path);
+        free(path);
+    } else if (config->replay_arrivals != NULL) {
+        char* path = terminal_name(config->replay_arrivals, index);
+        control_tower->arrivals = arrival_log_replay(path);
+        free(path);
+    }
+
+    if (config->load_snapshot != NULL) {
+        char* path = terminal_name(config->load_snapshot, index);
+        snapshot_load(control_tower, path);
+        free(path);
+    } else {
+        control_tower_populate(control_tower);
+    }
+    if (config->save_snapshot != NULL) {
+        char* path = terminal_name(config->save_snapshot, index);
+        snapshot_save(control_tower, path);
+        free(path);
+    }
+}
+
+void free_terminal(terminal_t* terminal) {
+    atomic_store(&terminal->locating, false);
+    sem_post(&terminal->stats->locate.request);
+    wait_success(&terminal->locate_thread, "locate");
+    stats_destroy(terminal->stats, terminal->stats_name);
+    free(terminal->stats_name);
+
+    if (terminal->control_tower->arrivals != NULL) {
+        arrival_log_close(terminal->control_tower->arrivals);
+    }
+
+    free_control_tower(terminal->control_tower);
+    free_crane(terminal->crane_alpha);
+    free_crane(terminal->crane_beta);
+    shared_free(terminal->control_tower);
+    shared_free(terminal->crane_alpha);
+    shared_free(terminal->crane_beta);
+
+    pthread_mutex_destroy(&terminal->channel.mutex);
+}
+
+/// Answers the track-and-trace queries of the viewers (see `stats_locate`) until the terminal is freed
+void* terminal_locate_entry(void* data) {
+    terminal_t* terminal = (terminal_t*)data;
+    locate_query_t* query = &terminal->stats->locate;
+
+    while (true) {
+        while (sem_wait(&query->request) != 0) {}
+        if (!atomic_load(&terminal->locating)) break;
+
+        container_location_t location;
+        stats_location_t* answer = &query->location;
+        answer->found = container_index_locate(query->ulid, &location);
+        if (answer->found) {
+            snprintf(answer->place, sizeof(answer->place), "%s", container_place_name(location.place));
+            answer->vehicle = (uint64_t)(uintptr_t)location.vehicle;
+            answer->slot = location.slot;
+        }
+        sem_post(&query->answer);
+    }
+
+    return NULL;
+}
+
+void terminal_start(terminal_t* terminal) {
+    if (terminal->processes) {
+        pfork(&terminal->pid_alpha, crane_entry, (void*)terminal->crane_alpha, terminal->cpu_alpha);
+        usleep(50000);
+        pfork(&terminal->pid_beta, crane_entry, (void*)terminal->crane_beta, terminal->cpu_beta);
+        pfork(&terminal->pid_tower, control_tower_entry, (void*)terminal->control_tower, terminal->cpu_tower);
+    } else {
+        lfork(&terminal->crane_alpha->thread, crane_entry, (void*)terminal->crane_alpha, terminal->cpu_alpha);
+        usleep(50000);
+        lfork(&terminal->crane_beta->thread, crane_entry, (void*)terminal->crane_beta, terminal->cpu_beta);
+        lfork(&terminal->control_tower->thread, control_tower_entry, (void*)terminal->control_tower, terminal->cpu_tower);
+    }
+
+    // Runs in the main process in both modes, which sees the index and the vehicles at the same address as the agents
+    atomic_store(&terminal->locating, true);
+    lfork(&terminal->locate_thread, terminal_locate_entry, (void*)terminal, -1);
+}
+
+void terminal_join(terminal_t* terminal) {
+    if (terminal->processes) {
+        wait_process(terminal->pid_alpha, "crane_alpha");
+        wait_process(terminal->pid_beta, "crane_beta");
+        wait_process(terminal->pid_tower, "control_tower");
+        return;
+    }
+
+    wait_success(&terminal->crane_alpha->thread, "crane_alpha");
+    wait_success(&terminal->crane_beta->thread, "crane_beta");
+    wait_success(&terminal->control_tower->thread, "control_tower");
+}
+
+void terminal_print(terminal_t* terminal) {
+    crane_t* crane_alpha = terminal->crane_alpha;
+    crane_t* crane_beta = terminal->crane_beta;
+    control_tower_t* control_tower = terminal->control_tower;
+
+    char prefix[32] = "";
+    if (terminal->n_terminals > 1) snprintf(prefix, sizeof(prefix), "Terminal %zu ", terminal->index);
+
+    double elapsed_alpha = crane_elapsed(crane_alpha);
+    double elapsed_beta = crane_elapsed(crane_beta);
+    double elapsed = elapsed_alpha > elapsed_beta ? elapsed_alpha : elapsed_beta;
+    size_t moves = crane_alpha->moves + crane_beta->moves;
+    printf(
+        "%sMoves: %zu (alpha: %zu, beta: %zu) in %.3f ms, %.0f moves/s\n",
+        prefix,
+        moves,
+        crane_alpha->moves,
+        crane_beta->moves,
+        elapsed * 1000.0,
+        elapsed > 0 ? moves / elapsed : 0.0
+    );
+    printf(
+        "%sMigrations: alpha: %zu (last CPU: %d), beta: %zu (last CPU: %d), tower: %zu (last CPU: %d)\n",
+        prefix,
+        crane_alpha->cpu.migrations,
+        crane_alpha->cpu.cpu,
+        crane_beta->cpu.migrations,
+        crane_beta->cpu.cpu,
+        control_tower->cpu.migrations,
+        control_tower->cpu.cpu
+    );
+    if (crane_alpha->yard.height > 0) {
+        yard_print(prefix, "alpha", &crane_alpha->yard);
+        yard_print(prefix, "beta", &crane_beta->yard);
+    }
+    if (crane_alpha->timed) {
+        crane_timing_print(prefix, &crane_alpha->timing, &crane_beta->timing);
+    }
+    train_lane_print_locks(prefix, "alpha", &crane_alpha->train_lane);
+    train_lane_print_locks(prefix, "beta", &crane_beta->train_lane);
+    queue_stats_print(prefix, "alpha", &terminal->stats->alpha.queue);
+    queue_stats_print(prefix, "beta", &terminal->stats->beta.queue);
+    queue_stats_print(prefix, "gamma", &terminal->stats->tower.queue);
+
+    if (terminal->transfer) {
+        printf(
+            "%sTransfers: %zu sent, %zu received, %zu unloaded, %zu waiting at the cranes, %zu left in the channel, "
+            "channel full %zu times\n",
+            prefix,
+            crane_alpha->transfers_sent + crane_beta->transfers_sent,
+            terminal->channel.received,
+            crane_alpha->transfers_unloaded + crane_beta->transfers_unloaded,
+            terminal->channel.drained - crane_alpha->transfers_unloaded - crane_beta->transfers_unloaded,
+            terminal->channel.length,
+            terminal->channel.full
+        );
+    }
+}
+
+bool terminal_serves(const terminal_t* terminal, size_t destination) {
+    return !terminal->transfer || destination % terminal->n_terminals == terminal->index;
+}
+
+size_t terminal_destination(const terminal_t* terminal) {
+    if (!terminal->transfer) return rand() % N_DESTINATIONS;
+
+    // Destinations index, index + K, index + 2K, ...
+    size_t n_served = (N_DESTINATIONS - terminal->index + terminal->n_terminals - 1) / terminal->n_terminals;
+    passert_gt(size_t, "%zu", n_served, 0, "Terminal %zu doesn't serve any destination", terminal->index);
+
+    return terminal->index + (rand() % n_served) * terminal->n_terminals;
+}
+
+bool terminal_transfer(terminal_t* terminal, container_holder_t* holder) {
+    passert(!container_holder_is_empty(holder), "Expected the container holder to have a container.");
+
+    terminal_t* target = &terminal->terminals[holder->container.destination % terminal->n_terminals];
+    transfer_channel_t* channel = &target->channel;
+
+    passert_eq(int, "%d", pthread_mutex_lock(&channel->mutex), 0);
+    if (channel->length == TRANSFER_CHANNEL_CAPACITY) {
+        channel->full++;
+        passert_eq(int, "%d", pthread_mutex_unlock(&channel->mutex), 0);
+        return false;
+    }
+
+    transfer_container(holder, &channel->containers[(channel->begin + channel->length) % TRANSFER_CHANNEL_CAPACITY]);
+    channel->length++;
+    channel->received++;
+    passert_eq(int, "%d", pthread_mutex_unlock(&channel->mutex), 0);
+
+    // The cranes of the target terminal have something new to move
+    control_tower_progress(target->control_tower);
+
+    return true;
+}
+
+size_t terminal_receive(terminal_t* terminal, container_holder_t* holders, size_t n_holders) {
+    transfer_channel_t* channel = &terminal->channel;
+    size_t res = 0;
+
+    passert_eq(int, "%d", pthread_mutex_lock(&channel->mutex), 0);
+    for (size_t n = 0; n < n_holders && channel->length > 0; n++) {
+        if (!container_holder_is_empty(&holders[n])) continue;
+
+        transfer_container(&channel->containers[channel->begin], &holders[n]);
+        channel->begin = (channel->begin + 1) % TRANSFER_CHANNEL_CAPACITY;
+        channel->length--;
+        res++;
+    }
+    channel->drained += res;
+    passert_eq(int, "%d", pthread_mutex_unlock(&channel->mutex), 0);
+
+    return res;
+}
+
+void lfork(pthread_t* res, void* (*entry)(void*), void* data, int cpu) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+
+    if (cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        passert_eq(int, "%d", pthread_attr_setaffinity_np(&attributes, sizeof(cpu_set_t), &cpus), 0);
+    }
+
+    passert_eq(int, "%d", pthread_create(res, &attributes, entry, data), 0);
+    pthread_attr_destroy(&attributes);
+}
+
+void wait_success(pthread_t* thread, char* name) {
+    passert_eq(
+        int, "%d",
+        pthread_join(*thread, NULL), 0,
+        "Thread %s didn't terminate normally.", name
+    );
+}
+
+/// Runs `entry` in a child process, which sees the shared region at the same address as the parent
+void pfork(pid_t* res, void* (*entry)(void*), void* data, int cpu) {
+    // Anything still buffered would otherwise be written by both processes
+    fflush(NULL);
+
+    pid_t pid = fork();
+    passert_gte(int, "%d", pid, 0, "Couldn't fork");
+
+    if (pid == 0) {
+        if (cpu >= 0) pin_current_thread(cpu);
+        entry(data);
+        exit(0);
+    }
+
+    *res = pid;
+}
+
+void wait_process(pid_t pid, char* name) {
+    int status;
+    passert_eq(int, "%d", waitpid(pid, &status, 0), pid);
+    passert(
+        WIFEXITED(status) && WEXITSTATUS(status) == 0,
+        "Process %s (%d) didn't terminate normally.", name, pid
+    );
+}
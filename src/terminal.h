@@ -0,0 +1,115 @@
+/*! # terminal.h
+
+A terminal is a control tower and its two cranes. Several independent terminals can run side by side in the same process,
+each with its own agents, vehicles, statistics segment and CPUs.
+
+With `--transfer`, the destinations are split between the terminals (destination `d` is served by terminal `d % K`):
+the vehicles of a terminal only leave for the destinations it serves, and a crane sends any container whose destination
+is served elsewhere over the transfer channel of the terminal serving it, from which that terminal's cranes pick it up.
+
+Each terminal stops on its own once its agents are stuck; containers sent to a terminal that already stopped are left
+in its channel.
+*/
+
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+struct terminal;
+
+/// The number of containers that a transfer channel, and the inbound buffer of a crane, can hold
+#define TRANSFER_CHANNEL_CAPACITY 64
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "container.h"
+#include "control_tower.h"
+#include "crane.h"
+#include "config.h"
+#include "stats.h"
+#include "cache_line.h"
+
+/// Ring buffer of the containers sent to a terminal by the other terminals.
+/// Written by the cranes of any terminal, drained by the cranes of the receiving terminal
+struct transfer_channel {
+    CACHE_ALIGNED pthread_mutex_t mutex;
+    container_holder_t containers[TRANSFER_CHANNEL_CAPACITY];
+    size_t begin;
+    size_t length;
+
+    /// The number of containers that were pushed into/drained from the channel, written while holding the mutex
+    size_t received;
+    size_t drained;
+    /// The number of times the channel was full when a crane tried to send a container
+    size_t full;
+};
+typedef struct transfer_channel transfer_channel_t;
+
+struct terminal {
+    size_t index;
+
+    /// Every terminal of the process, including this one
+    struct terminal* terminals;
+    size_t n_terminals;
+    /// Whether the destinations are split between the terminals
+    bool transfer;
+
+    struct control_tower* control_tower;
+    struct crane* crane_alpha;
+    struct crane* crane_beta;
+
+    /// The CPUs of the agents, or -1 if they aren't pinned
+    int cpu_alpha;
+    int cpu_beta;
+    int cpu_tower;
+
+    /// Whether the agents run as processes rather than threads, see `shared_memory.h`; their pids if they do
+    bool processes;
+    pid_t pid_alpha;
+    pid_t pid_beta;
+    pid_t pid_tower;
+
+    char* stats_name;
+    platform_stats_t* stats;
+    /// Answers the track-and-trace queries made through the statistics segment, from the start of the terminal until
+    /// it is freed; since the container index is shared, it answers for the containers of every terminal
+    pthread_t locate_thread;
+    atomic_bool locating;
+
+    /// Containers sent by the other terminals
+    transfer_channel_t channel;
+};
+typedef struct terminal terminal_t;
+
+/// Returns the name of the file or segment `base` for the terminal `index`: `base` itself for the first terminal,
+/// `base.<index>` for the others. The result must be freed
+char* terminal_name(const char* base, size_t index);
+
+/// Creates the agents of the terminal `index` among `terminals` and populates the platform (or restores its snapshot).
+/// If the agents run as processes, `terminals` must have been allocated with `shared_malloc`
+void init_terminal(terminal_t* terminal, size_t index, terminal_t* terminals, size_t n_terminals, const config_t* config);
+
+/// Should be called once for each terminal, after its agents stopped
+void free_terminal(terminal_t* terminal);
+
+/// Starts and waits for the agents of the terminal, as threads or as processes
+void terminal_start(terminal_t* terminal);
+void terminal_join(terminal_t* terminal);
+
+/// Prints the moves, migrations and transfers of the terminal
+void terminal_print(terminal_t* terminal);
+
+/// Returns true if the vehicles of the terminal may leave for `destination`
+bool terminal_serves(const terminal_t* terminal, size_t destination);
+
+/// Returns a random destination among the ones the terminal serves
+size_t terminal_destination(const terminal_t* terminal);
+
+/// Sends the container of `holder` to the terminal serving its destination, emptying `holder`.
+/// Returns false if that terminal's channel is full, in which case `holder` is left untouched
+bool terminal_transfer(terminal_t* terminal, container_holder_t* holder);
+
+/// Moves the containers of the terminal's channel into the empty holders among `holders`; returns how many were moved
+size_t terminal_receive(terminal_t* terminal, container_holder_t* holders, size_t n_holders);
+
+#endif // TERMINAL_H
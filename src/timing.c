@@ -0,0 +1,74 @@
+#include "timing.h"
+#include <stdio.h>
+#include <math.h>
+#include "boat.h"
+
+/// Where each lane is across the platform, in meters from the quay
+static const double LANE_OFFSETS[N_CONTAINER_PLACES] = {
+    [CONTAINER_ON_BOAT] = 0.0,
+    [CONTAINER_ON_WAGON] = 15.0,
+    [CONTAINER_ON_TRUCK] = 25.0,
+    [CONTAINER_AT_CRANE] = 35.0,
+    [CONTAINER_IN_TRANSFER] = 35.0,
+    [CONTAINER_IN_YARD] = 45.0,
+};
+
+crane_timing_t new_crane_timing() {
+    crane_timing_t res;
+    res.position = timing_slot(CONTAINER_ON_TRUCK, 0);
+    res.busy = 0.0;
+    res.loaded = 0.0;
+    res.travelled = 0.0;
+    return res;
+}
+
+position_t timing_slot(enum container_place place, size_t slot) {
+    position_t res;
+    res.y = LANE_OFFSETS[place];
+
+    // The boat lane goes the other way
+    if (place == CONTAINER_ON_BOAT) {
+        res.x = (double)(BOAT_CONTAINERS - 1 - slot % BOAT_CONTAINERS) * CRANE_SLOT_LENGTH;
+    } else {
+        res.x = (double)slot * CRANE_SLOT_LENGTH;
+    }
+
+    return res;
+}
+
+double timing_travel(position_t from, position_t to) {
+    double gantry = fabs(to.x - from.x) / CRANE_GANTRY_SPEED;
+    double trolley = fabs(to.y - from.y) / CRANE_TROLLEY_SPEED;
+    return gantry > trolley ? gantry : trolley;
+}
+
+/// Returns the distance between `from` and `to`, in meters
+double timing_distance(position_t from, position_t to) {
+    return hypot(to.x - from.x, to.y - from.y);
+}
+
+void crane_timing_move(crane_timing_t* timing, position_t from, position_t to) {
+    double empty = timing_travel(timing->position, from);
+    double carrying = CRANE_HOIST_TIME + timing_travel(from, to) + CRANE_HOIST_TIME;
+
+    timing->busy += empty + carrying;
+    timing->loaded += carrying;
+    timing->travelled += timing_distance(timing->position, from) + timing_distance(from, to);
+    timing->position = to;
+}
+
+void crane_timing_print(const char* prefix, const crane_timing_t* alpha, const crane_timing_t* beta) {
+    double makespan = alpha->busy > beta->busy ? alpha->busy : beta->busy;
+    printf(
+        "%sTiming: makespan %.1f s, alpha: %.1f s busy, %.0f%% utilisation, %.0f m travelled, "
+        "beta: %.1f s busy, %.0f%% utilisation, %.0f m travelled\n",
+        prefix,
+        makespan,
+        alpha->busy,
+        makespan > 0 ? alpha->loaded / makespan * 100.0 : 0.0,
+        alpha->travelled,
+        beta->busy,
+        makespan > 0 ? beta->loaded / makespan * 100.0 : 0.0,
+        beta->travelled
+    );
+}
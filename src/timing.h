@@ -0,0 +1,84 @@
+/*! # timing.h
+
+Physical timing model of the cranes, enabled with `--timing`.
+
+The moves of the containers stay instantaneous, but each crane also keeps a simulated clock: every move costs the time
+that a real crane would need to travel from where it is to the source slot, pick the container up, carry it to the
+target slot and set it down. The crane then stays above the target slot until its next move.
+
+Each crane works on its own half of the platform (see the design in the README), so positions are relative to that half:
+- `x` runs along the lanes, one slot (`CRANE_SLOT_LENGTH`) per container; the boat lane runs in the opposite direction
+  to the train lane, so the first slot of the boat at bay is at the far end
+- `y` runs across the lanes: the boat lane on the quay side, then the train lane, the road lane, the buffer in which
+  the crane exchanges containers with the other terminals (see `terminal.h`), and the yard (see `yard.h`), with one
+  stack per destination along it
+
+The gantry (along `x`) and the trolley (along `y`) move at the same time, so travelling takes as long as the slower of
+the two; picking a container up or setting it down takes `CRANE_HOIST_TIME`.
+
+Since the simulated clock only advances with moves, the makespan of a terminal is the busy time of its busiest crane,
+and the utilisation of a crane is the share of that makespan during which it carried a container.
+The speeds can be overriden at compile time, for instance with `make DEFINES="CRANE_GANTRY_SPEED=1.0"`.
+*/
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdlib.h>
+#include "container_index.h"
+
+/// The length of a slot along the lanes, in meters (a 40-foot container)
+#ifndef CRANE_SLOT_LENGTH
+#define CRANE_SLOT_LENGTH 12.2
+#endif
+
+/// The speeds of the gantry (along the lanes) and of the trolley (across the lanes), in meters per second
+#ifndef CRANE_GANTRY_SPEED
+#define CRANE_GANTRY_SPEED 0.75
+#endif
+#ifndef CRANE_TROLLEY_SPEED
+#define CRANE_TROLLEY_SPEED 2.5
+#endif
+
+/// The time to lower the spreader, lock or unlock a container and hoist it back up, in seconds
+#ifndef CRANE_HOIST_TIME
+#define CRANE_HOIST_TIME 15.0
+#endif
+
+/// A position on the half of the platform of a crane, in meters
+struct position {
+    double x;
+    double y;
+};
+typedef struct position position_t;
+
+/// The simulated clock of a crane
+struct crane_timing {
+    /// Where the spreader of the crane is
+    position_t position;
+
+    /// The time spent moving containers, and the part of it during which the crane carried one, in seconds
+    double busy;
+    double loaded;
+
+    /// The distance travelled by the crane, in meters
+    double travelled;
+};
+typedef struct crane_timing crane_timing_t;
+
+/// Creates the clock of a crane, which starts above the first slot of the road lane
+crane_timing_t new_crane_timing();
+
+/// Returns the position of the `slot`-th slot of the lane `place`, counting the slots of every vehicle in the lane
+position_t timing_slot(enum container_place place, size_t slot);
+
+/// Returns the time that a crane needs to travel from `from` to `to`, in seconds
+double timing_travel(position_t from, position_t to);
+
+/// Advances the clock of a crane by a move from `from` to `to`, and leaves the crane at `to`
+void crane_timing_move(crane_timing_t* timing, position_t from, position_t to);
+
+/// Prints the makespan of the two cranes of a terminal, and the utilisation of each of them
+void crane_timing_print(const char* prefix, const crane_timing_t* alpha, const crane_timing_t* beta);
+
+#endif // TIMING_H
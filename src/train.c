@@ -1,31 +1,19 @@
 #include "train.h"
 #include "assert.h"
+#include "shared_memory.h"
+#include "container_index.h"
 #include "ulid.h"
 #include <pthread.h>
+#include <string.h>
+#include <time.h>
 
 wagon_t new_wagon(const train_t* train, size_t n_cargo) {
-    struct ulid_generator* generator = get_generator();
     wagon_t res;
 
     res.destination = train->destination;
     res.train = train;
-
-    size_t n = 0;
-    for (; n < n_cargo && n < WAGON_CONTAINERS; n++) { // fill the n_cargo first elements with random destinations
-        size_t dest = rand() % N_DESTINATIONS;
-        if (dest == train->destination && N_DESTINATIONS > 1) {
-            // (X ~> U[0; n[) + (Y ~> U[0; n[) ~> U[0; n[ in the finite field (ℕ mod n)
-            dest = (dest + rand() % (N_DESTINATIONS - 1)) % N_DESTINATIONS;
-        }
-        res.containers[n] = new_container_holder(false, dest);
-    }
-    for (; n < WAGON_CONTAINERS; n++) { // fill the other elements with empty slots
-        res.containers[n] = new_container_holder(true, 0);
-    }
-
-    char encoded[27];
-    ulid_generate(generator, encoded);
-    ulid_decode(res.ulid, encoded);
+    wagon_fill(&res, train->destination, n_cargo);
+    vehicle_new_ulid(res.ulid);
 
     return res;
 }
@@ -43,64 +31,175 @@ void print_wagon(wagon_t* wagon, bool newline) {
         newline ? "\n" : ""
     );
 
-    for (size_t n = 0; n < WAGON_CONTAINERS; n++) {
-        if (newline) printf("  ");
-        print_container_holder(&wagon->containers[n], false);
-        if (n < WAGON_CONTAINERS - 1) printf(", %s", newline ? "\n" : "");
-    }
+    wagon_print_containers(wagon, newline);
 
     printf("%s] }%s", newline ? "\n" : "", newline ? "\n" : "");
 }
 
-bool wagon_is_full(wagon_t* wagon) {
-    for (size_t n = 0; n < WAGON_CONTAINERS; n++) {
-        if (wagon->containers[n].is_empty) return false;
+void init_train(train_t* train, size_t destination, size_t n_wagons) {
+    passert_lt(size_t, "%zu", destination, N_DESTINATIONS);
+    train->destination = destination;
+    train->n_wagons = n_wagons <= TRAIN_WAGONS ? n_wagons : TRAIN_WAGONS;
+
+    for (size_t n = 0; n < train->n_wagons; n++) {
+        train->wagons[n] = new_wagon(train, rand() % WAGON_CONTAINERS);
+        train->wagon_full[n] = false;
+        // β never reports wagons that arrive without cargo, so flag them right away
+        train->wagon_empty[n] = wagon_is_empty(&train->wagons[n]);
     }
-    return true;
+
+    train->offset = 0;
 }
 
-bool wagon_is_empty(wagon_t* wagon) {
-    for (size_t n = 0; n < WAGON_CONTAINERS; n++) {
-        if (!wagon->containers[n].is_empty) return false;
+train_t* new_train(size_t destination, size_t n_wagons) {
+    train_t* res = shared_malloc(sizeof(train_t));
+    passert_neq(train_t*, "%p", res, NULL);
+
+    init_train(res, destination, n_wagons);
+
+    return res;
+}
+
+void free_train(train_t* train) {
+    shared_free(train);
+}
+
+bool train_is_full(const train_t* train) {
+    for (size_t n = 0; n < train->n_wagons; n++) {
+        if (!train->wagon_full[n]) return false;
     }
     return true;
 }
 
-size_t wagon_loaded(wagon_t* wagon) {
-    size_t res = 0;
-    for (size_t n = 0; n < WAGON_CONTAINERS; n++) {
-        if (!wagon->containers[n].is_empty) res += 1;
+train_pipeline_t new_train_pipeline() {
+    train_pipeline_t res;
+    for (size_t n = 0; n < TRAIN_PIPELINE; n++) {
+        res.trains[n] = NULL;
     }
+    res.begin = 0;
+    res.length = 0;
+    res.head = 0;
+
     return res;
 }
 
-container_holder_t* wagon_first_empty(wagon_t* wagon) {
-    for (size_t n = 0; n < WAGON_CONTAINERS; n++) {
-        if (wagon->containers[n].is_empty) return &wagon->containers[n];
+train_t* train_pipeline_get(train_pipeline_t* pipeline, size_t n) {
+    if (n >= pipeline->length) return NULL;
+    return pipeline->trains[(pipeline->begin + n) % TRAIN_PIPELINE];
+}
+
+train_t* train_pipeline_head(train_pipeline_t* pipeline) {
+    return train_pipeline_get(pipeline, pipeline->head);
+}
+
+train_t* train_pipeline_tail(train_pipeline_t* pipeline) {
+    return train_pipeline_get(pipeline, 0);
+}
+
+void train_pipeline_push(train_pipeline_t* pipeline, train_t* train) {
+    passert_lt(size_t, "%zu", pipeline->length, TRAIN_PIPELINE, "No more space left in the train pipeline!");
+
+    pipeline->trains[(pipeline->begin + pipeline->length) % TRAIN_PIPELINE] = train;
+    pipeline->length++;
+}
+
+train_t* train_pipeline_pop(train_pipeline_t* pipeline) {
+    passert_gt(size_t, "%zu", pipeline->head, 0, "The tail of the train pipeline wasn't transferred yet!");
+
+    train_t* res = pipeline->trains[pipeline->begin];
+    pipeline->trains[pipeline->begin] = NULL;
+    pipeline->begin = (pipeline->begin + 1) % TRAIN_PIPELINE;
+    pipeline->length--;
+    pipeline->head--;
+
+    return res;
+}
+
+train_t* train_pipeline_find(train_pipeline_t* pipeline, const wagon_t* wagon, size_t* index) {
+    for (size_t t = 0; t < pipeline->length; t++) {
+        train_t* train = train_pipeline_get(pipeline, t);
+        for (size_t n = 0; n < train->n_wagons; n++) {
+            if (&train->wagons[n] == wagon) {
+                *index = n;
+                return train;
+            }
+        }
     }
     return NULL;
 }
 
-train_t* new_train(size_t destination, size_t n_wagons) {
-    train_t* res = malloc(sizeof(train_t));
+train_pool_t new_train_pool(size_t capacity) {
+    passert_gt(size_t, "%zu", capacity, 0, "Capacity may not be zero.");
 
-    passert_lt(size_t, "%zu", destination, N_DESTINATIONS);
-    res->destination = destination;
-    res->n_wagons = n_wagons <= TRAIN_WAGONS ? n_wagons : TRAIN_WAGONS;
+    train_pool_t res;
+    res.trains = (train_t*)shared_calloc(capacity, sizeof(train_t));
+    passert_neq(train_t*, "%p", res.trains, NULL, "Couldn't allocate %zu bytes of memory", capacity * sizeof(train_t));
+    res.available = (train_t**)shared_malloc(capacity * sizeof(train_t*));
+    passert_neq(train_t**, "%p", res.available, NULL);
+    res.capacity = capacity;
 
-    for (size_t n = 0; n < n_wagons && n < TRAIN_WAGONS; n++) {
-        res->wagons[n] = new_wagon(res, rand() % WAGON_CONTAINERS);
-        res->wagon_full[n] = false;
-        res->wagon_empty[n] = false;
+    // Hand out the trains in order
+    for (size_t n = 0; n < capacity; n++) {
+        res.available[n] = &res.trains[capacity - n - 1];
+        container_index_register(CONTAINER_ON_WAGON, res.trains[n].wagons, TRAIN_WAGONS, sizeof(wagon_t));
     }
+    res.n_available = capacity;
 
-    res->offset = 0;
+    res.in_use = 0;
+    res.high_water = 0;
+    res.acquired = 0;
+    res.recycled = 0;
 
     return res;
 }
 
-void free_train(train_t* train) {
-    free(train);
+void free_train_pool(train_pool_t* pool) {
+    shared_free(pool->trains);
+    shared_free(pool->available);
+    pool->capacity = 0;
+    pool->n_available = 0;
+}
+
+train_t* train_pool_alloc(train_pool_t* pool) {
+    passert_gt(size_t, "%zu", pool->n_available, 0, "The train pool is exhausted!");
+
+    pool->n_available--;
+    train_t* res = pool->available[pool->n_available];
+
+    pool->in_use++;
+    pool->acquired++;
+    if (pool->in_use > pool->high_water) pool->high_water = pool->in_use;
+
+    return res;
+}
+
+train_t* train_pool_acquire(train_pool_t* pool, size_t destination, size_t n_wagons) {
+    train_t* res = train_pool_alloc(pool);
+    init_train(res, destination, n_wagons);
+
+    return res;
+}
+
+void train_pool_release(train_pool_t* pool, train_t* train) {
+    passert(train >= pool->trains && train < pool->trains + pool->capacity, "Train doesn't belong to this pool!");
+    passert_lt(size_t, "%zu", pool->n_available, pool->capacity);
+
+    pool->available[pool->n_available] = train;
+    pool->n_available++;
+
+    pool->in_use--;
+    pool->recycled++;
+}
+
+void train_pool_print(train_pool_t* pool) {
+    printf(
+        "TrainPool { capacity = %zu, in_use = %zu, high_water = %zu, acquired = %zu, recycled = %zu }\n",
+        pool->capacity,
+        pool->in_use,
+        pool->high_water,
+        pool->acquired,
+        pool->recycled
+    );
 }
 
 train_lane_t new_train_lane() {
@@ -108,10 +207,19 @@ train_lane_t new_train_lane() {
     for (size_t n = 0; n < LANE_WAGONS; n++) {
         res.wagons[n] = NULL;
     }
+    memset(res.keys, 0, sizeof(res.keys));
     res.n_wagons = 0;
+    atomic_init(&res.lock_waits, 0);
+#ifdef TRAIN_LANE_HOLD_TIME
+    res.locked = 0;
+    res.holds = 0;
+    res.held = 0;
+    res.max_held = 0;
+#endif
 
     pthread_mutexattr_t attributes;
     passert_eq(int, "%d", pthread_mutexattr_init(&attributes), 0);
+    passert_eq(int, "%d", pthread_mutexattr_setpshared(&attributes, 1), 0);
     passert_eq(int, "%d", pthread_mutex_init(&res.mutex, &attributes), 0);
     passert_eq(int, "%d", pthread_mutexattr_destroy(&attributes), 0);
 
@@ -122,16 +230,57 @@ void free_train_lane(train_lane_t* train_lane) {
     pthread_mutex_destroy(&train_lane->mutex);
 }
 
+#ifdef TRAIN_LANE_HOLD_TIME
+uint64_t train_lane_clock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+#endif
+
 void train_lane_lock(train_lane_t* train_lane) {
-    pthread_mutex_lock(&train_lane->mutex);
+    if (pthread_mutex_trylock(&train_lane->mutex) != 0) {
+        atomic_fetch_add_explicit(&train_lane->lock_waits, 1, memory_order_relaxed);
+        pthread_mutex_lock(&train_lane->mutex);
+    }
+
+#ifdef TRAIN_LANE_HOLD_TIME
+    train_lane->locked = train_lane_clock();
+#endif
 }
 void train_lane_unlock(train_lane_t* train_lane) {
+#ifdef TRAIN_LANE_HOLD_TIME
+    uint64_t held = train_lane_clock() - train_lane->locked;
+    train_lane->holds++;
+    train_lane->held += held;
+    if (held > train_lane->max_held) train_lane->max_held = held;
+#endif
+
     pthread_mutex_unlock(&train_lane->mutex);
 }
 
+void train_lane_print_locks(const char* prefix, const char* name, train_lane_t* train_lane) {
+    printf(
+        "%sTrain lane %s: %zu lock waits",
+        prefix,
+        name,
+        atomic_load_explicit(&train_lane->lock_waits, memory_order_relaxed)
+    );
+#ifdef TRAIN_LANE_HOLD_TIME
+    printf(
+        ", held %zu times for %.3f us on average, %.3f us at most",
+        train_lane->holds,
+        train_lane->holds > 0 ? train_lane->held / (double)train_lane->holds / 1e3 : 0.0,
+        train_lane->max_held / 1e3
+    );
+#endif
+    printf("\n");
+}
+
 void train_lane_shift(train_lane_t* train_lane, size_t shift_by) {
     for (size_t n = shift_by; n < train_lane->n_wagons; n++) {
         train_lane->wagons[n - shift_by] = train_lane->wagons[n];
+        train_lane->keys[n - shift_by] = train_lane->keys[n];
     }
     if (train_lane->n_wagons > shift_by) train_lane->n_wagons -= shift_by;
     else train_lane->n_wagons = 0;
@@ -141,6 +290,7 @@ void train_lane_append(train_lane_t* train_lane, wagon_t* wagon) {
     passert_lt(size_t, "%zu", train_lane->n_wagons, LANE_WAGONS, "No more space left to add wagons in the lane!");
 
     train_lane->wagons[train_lane->n_wagons] = wagon;
+    train_lane_refresh(train_lane, train_lane->n_wagons);
     train_lane->n_wagons++;
 }
 
@@ -153,7 +303,7 @@ void train_lane_print(train_lane_t* train_lane, bool short_version) {
             wagon_t* wagon = train_lane->wagons[n];
             printf("(");
             for (size_t o = 0; o < WAGON_CONTAINERS; o++) {
-                if (wagon->containers[o].is_empty) {
+                if (container_holder_is_empty(&wagon->containers[o])) {
                     printf("-");
                 } else if (wagon->destination != wagon->containers[o].container.destination) {
                     printf("x");
@@ -170,12 +320,42 @@ void train_lane_print(train_lane_t* train_lane, bool short_version) {
     printf("] }\n");
 }
 
-wagon_t* train_lane_accepts(train_lane_t* train_lane, size_t destination) {
-    for (size_t n = 0; n < train_lane->n_wagons; n++) {
-        wagon_t* wagon = train_lane->wagons[n];
+wagon_t* train_lane_accepts(train_lane_t* train_lane, size_t destination, size_t* index) {
+    *index = lane_match_accepts(train_lane->keys, train_lane->n_wagons, destination);
+    return *index < train_lane->n_wagons ? train_lane->wagons[*index] : NULL;
+}
 
-        if (wagon->destination == destination && !wagon_is_full(wagon)) return wagon;
+size_t train_lane_next_accepting(train_lane_t* train_lane, size_t destination, size_t from) {
+    return lane_match_next_accepting(train_lane->keys, from, train_lane->n_wagons, destination);
+}
+
+size_t train_lane_next_cargo(train_lane_t* train_lane, size_t from) {
+    return lane_match_next(train_lane->keys, from, train_lane->n_wagons, LANE_KEY_EMPTY, 0);
+}
+
+void train_lane_refresh(train_lane_t* train_lane, size_t index) {
+    wagon_t* wagon = train_lane->wagons[index];
+    train_lane->keys[index] = lane_key(wagon->destination, wagon_is_full(wagon), wagon_is_empty(wagon));
+}
+
+void train_lane_snapshot(const train_lane_t* train_lane, train_lane_t* plan) {
+    memcpy(plan->wagons, train_lane->wagons, train_lane->n_wagons * sizeof(wagon_t*));
+    memcpy(plan->keys, train_lane->keys, sizeof(plan->keys));
+    plan->n_wagons = train_lane->n_wagons;
+}
+
+size_t train_lane_merge(train_lane_t* train_lane, const train_lane_t* plan) {
+    size_t res = 0;
+
+    for (size_t n = 0; n < plan->n_wagons; n++) {
+        // The control tower may have shifted the lane since the snapshot, or moved the wagon out of it
+        size_t index = 0;
+        while (index < train_lane->n_wagons && train_lane->wagons[index] != plan->wagons[n]) index++;
+        if (index == train_lane->n_wagons || train_lane->keys[index] == plan->keys[n]) continue;
+
+        train_lane_refresh(train_lane, index);
+        res++;
     }
 
-    return NULL;
+    return res;
 }
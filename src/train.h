@@ -7,11 +7,21 @@ Contains the `wagon_t` and `train_t` structures.
 #define TRAIN_H
 
 #include "container.h"
+#include "vehicle.h"
+#include "lane_match.h"
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #define WAGON_CONTAINERS 2
 #define TRAIN_WAGONS 4
-#define LANE_WAGONS (2 * TRAIN_WAGONS)
+
+/// The maximum number of trains in flight on the train lane;
+/// can be overriden at compile time with `make DEFINES="TRAIN_PIPELINE=4"`
+#ifndef TRAIN_PIPELINE
+#define TRAIN_PIPELINE 2
+#endif
+
+#define LANE_WAGONS (TRAIN_PIPELINE * TRAIN_WAGONS)
 
 struct train;
 
@@ -50,6 +60,9 @@ struct train {
 
     /// Guaranteed to be a valid index of DESTINATION_NAMES
     size_t destination;
+
+    /// When the train arrived on the platform, in seconds on the control tower's clock
+    double arrived;
 };
 typedef struct train train_t;
 
@@ -60,20 +73,110 @@ wagon_t new_wagon(const train_t* train, size_t n_cargo);
 void print_wagon(wagon_t* wagon, bool newline);
 
 /// Returns information about how loaded a wagon is
-bool wagon_is_full(wagon_t* wagon);
-bool wagon_is_empty(wagon_t* wagon);
-size_t wagon_loaded(wagon_t* wagon);
-container_holder_t* wagon_first_empty(wagon_t* wagon);;
+VEHICLE(wagon, wagon_t, WAGON_CONTAINERS)
+
+/// Initializes `train` in place, giving it new wagons and a new destination
+void init_train(train_t* train, size_t destination, size_t n_wagons);
 
 train_t* new_train(size_t destination, size_t n_wagons);
 
 void free_train(train_t* train);
 
+/// Returns true if all of the wagons of the train were flagged as full
+bool train_is_full(const train_t* train);
+
+/// Queue of the trains in flight, ordered from the oldest one (the tail) to the newest one.
+/// The trains before `head` have all of their wagons on α's side, the train at `head` is being transferred
+/// from β's side to α's side and the trains after it are still waiting on β's side.
+/// Only the control tower may access it, so it isn't protected by a mutex
+struct train_pipeline {
+    train_t* trains[TRAIN_PIPELINE];
+    size_t begin;
+    size_t length;
+
+    /// Index (from the tail) of the train whose wagons are being transferred
+    size_t head;
+};
+typedef struct train_pipeline train_pipeline_t;
+
+/// Creates a new, empty train pipeline
+train_pipeline_t new_train_pipeline();
+
+/// Returns the n-th train from the tail of the pipeline, or NULL if there are less than n trains
+train_t* train_pipeline_get(train_pipeline_t* pipeline, size_t n);
+
+/// Returns the train whose wagons are being transferred, or NULL if all of the trains were transferred
+train_t* train_pipeline_head(train_pipeline_t* pipeline);
+
+/// Returns the oldest train, or NULL if the pipeline is empty
+train_t* train_pipeline_tail(train_pipeline_t* pipeline);
+
+/// Pushes a new train at the end of the pipeline; the pipeline may not be full
+void train_pipeline_push(train_pipeline_t* pipeline, train_t* train);
+
+/// Removes and returns the oldest train of the pipeline, which must have been transferred already
+train_t* train_pipeline_pop(train_pipeline_t* pipeline);
+
+/// Finds the train that `wagon` belongs to and writes the index of the wagon into `index`.
+/// Returns NULL if the wagon doesn't belong to any train in the pipeline
+train_t* train_pipeline_find(train_pipeline_t* pipeline, const wagon_t* wagon, size_t* index);
+
+/// Pool of preallocated trains (and thus wagons), which get recycled once they have left the train lane.
+/// Only the control tower may access it, so it isn't protected by a mutex
+struct train_pool {
+    train_t* trains;
+    size_t capacity;
+
+    /// Stack of the trains that can be handed out
+    train_t** available;
+    size_t n_available;
+
+    /// Occupancy counters
+    size_t in_use;
+    size_t high_water;
+    size_t acquired;
+    size_t recycled;
+};
+typedef struct train_pool train_pool_t;
+
+/// Creates a new train pool, holding `capacity` trains
+train_pool_t new_train_pool(size_t capacity);
+
+/// Should be called once for every train_pool_t instance, after no wagon of the pool is in use anymore
+void free_train_pool(train_pool_t* pool);
+
+/// Takes a train from the pool without initializing it; the pool may not be exhausted
+train_t* train_pool_alloc(train_pool_t* pool);
+
+/// Takes a train from the pool and initializes it, see `init_train`
+train_t* train_pool_acquire(train_pool_t* pool, size_t destination, size_t n_wagons);
+
+/// Gives a train back to the pool; none of its wagons may be in a train lane anymore
+void train_pool_release(train_pool_t* pool, train_t* train);
+
+/// Prints the occupancy counters of the pool
+void train_pool_print(train_pool_t* pool);
+
 struct train_lane {
     wagon_t* wagons[LANE_WAGONS];
+    /// The key of each wagon (see `lane_match.h`), which must be refreshed whenever a container is loaded onto
+    /// or unloaded from it
+    lane_key_t keys[LANE_WAGONS + LANE_MATCH_WIDTH];
     size_t n_wagons;
 
     pthread_mutex_t mutex;
+
+    /// Number of times that locking the lane had to wait for another agent
+    atomic_size_t lock_waits;
+
+#ifdef TRAIN_LANE_HOLD_TIME
+    /// When the lane was last locked, the number of times it was locked, and for how long it was held in total
+    /// and at most, in nanoseconds; written while holding the lane
+    uint64_t locked;
+    size_t holds;
+    uint64_t held;
+    uint64_t max_held;
+#endif
 };
 typedef struct train_lane train_lane_t;
 
@@ -86,10 +189,16 @@ void free_train_lane(train_lane_t* train_lane);
 /// Used for debugging
 void train_lane_print(train_lane_t* train_lane, bool short_version);
 
-/// Locks and unlocks the underlying mutex
+/// Locks and unlocks the underlying mutex.
+/// Define `TRAIN_LANE_HOLD_TIME` (`make DEFINES=TRAIN_LANE_HOLD_TIME`) to also measure for how long the lane is held,
+/// see `results/measure-train-lane.sh`
 void train_lane_lock(train_lane_t* train_lane);
 void train_lane_unlock(train_lane_t* train_lane);
 
+/// Prints how often the lane of the crane `name` was locked and waited for, and for how long it was held
+/// if `TRAIN_LANE_HOLD_TIME` is defined
+void train_lane_print_locks(const char* prefix, const char* name, train_lane_t* train_lane);
+
 /// Shifts the wagons in the train lane by `shift_by` spots, removing the `shift_by` first wagons.
 /// Does *not* lock the underlying mutex
 void train_lane_shift(train_lane_t* train_lane, size_t shift_by);
@@ -98,9 +207,29 @@ void train_lane_shift(train_lane_t* train_lane, size_t shift_by);
 /// Does *not* lock the underlying mutex
 void train_lane_append(train_lane_t* train_lane, wagon_t* wagon);
 
-/// Finds and returns a wagon_t that can accept a container with destination `destination`;
+/// Finds and returns a wagon_t that can accept a container with destination `destination`, and writes its index into `index`;
 /// If none are found, returns NULL
 /// Does *not* lock the train lane (as the returned reference outlives the function's scope)
-wagon_t* train_lane_accepts(train_lane_t* train_lane, size_t destination);
+wagon_t* train_lane_accepts(train_lane_t* train_lane, size_t destination, size_t* index);
+
+/// Returns the index of the first wagon at or after `from` that can accept a container with destination `destination`,
+/// or `n_wagons` if there are none. Does *not* lock the train lane
+size_t train_lane_next_accepting(train_lane_t* train_lane, size_t destination, size_t from);
+
+/// Returns the index of the first wagon at or after `from` with a container to unload, or `n_wagons` if there are none.
+/// Does *not* lock the train lane
+size_t train_lane_next_cargo(train_lane_t* train_lane, size_t from);
+
+/// Updates the key of the `index`-th wagon, after containers were loaded onto or unloaded from it.
+/// Does *not* lock the train lane
+void train_lane_refresh(train_lane_t* train_lane, size_t index);
+
+/// Copies the wagons of `train_lane` and their keys into `plan`, whose mutex is never used, so that the moves onto and
+/// off the wagons can be planned without holding the lane. Does *not* lock the train lane
+void train_lane_snapshot(const train_lane_t* train_lane, train_lane_t* plan);
+
+/// Refreshes the keys of the wagons of `plan` that are still in `train_lane` and whose key differs from the one in `plan`,
+/// once their containers were moved; returns the number of keys refreshed. Does *not* lock the train lane
+size_t train_lane_merge(train_lane_t* train_lane, const train_lane_t* plan);
 
 #endif // TRAIN_H
@@ -1,44 +1,28 @@
 #include "truck.h"
 #include "assert.h"
+#include "shared_memory.h"
 #include "ulid.h"
 
 truck_t new_truck(size_t destination) {
-    struct ulid_generator* generator = get_generator();
     truck_t res;
 
     passert_lt(size_t, "%zu", destination, N_DESTINATIONS);
     res.destination = destination;
-
-    // Compute a uniform destination among [0; N_DESTINATIONS[ \ {destination}
-    size_t dest = rand() % N_DESTINATIONS;
-    if (dest == destination && N_DESTINATIONS > 1) {
-        dest = (dest + rand() % (N_DESTINATIONS - 1)) % N_DESTINATIONS;
-    }
-    res.container = new_container_holder(false, dest);
-
+    truck_fill(&res, destination, TRUCK_CONTAINERS);
     res.loading = false;
-
-    char encoded[27];
-    ulid_generate(generator, encoded);
-    ulid_decode(res.ulid, encoded);
+    vehicle_new_ulid(res.ulid);
 
     return res;
 }
 
 truck_t empty_truck(size_t destination) {
-    struct ulid_generator* generator = get_generator();
     truck_t res;
 
     passert_lt(size_t, "%zu", destination, N_DESTINATIONS);
     res.destination = destination;
-
-    res.container = new_container_holder(true, 0);
-
+    truck_fill(&res, destination, 0);
     res.loading = true;
-
-    char encoded[27];
-    ulid_generate(generator, encoded);
-    ulid_decode(res.ulid, encoded);
+    vehicle_new_ulid(res.ulid);
 
     return res;
 }
@@ -48,103 +32,107 @@ void print_truck(truck_t* truck, bool newline) {
     ulid_encode(encoded, truck->ulid);
 
     printf(
-        "Truck { destination = %s (%zu), ulid = %s, loading = %s, container =%s",
+        "Truck { destination = %s (%zu), ulid = %s, loading = %s, containers = [%s",
         DESTINATION_NAMES[truck->destination],
         truck->destination,
         encoded,
         truck->loading ? "true" : "false",
-        newline ? "\n" : " "
+        newline ? "\n" : ""
     );
 
-    print_container_holder(&truck->container, true);
+    truck_print_containers(truck, newline);
 
-    printf("}%s", newline ? "\n" : "");
+    printf("%s] }%s", newline ? "\n" : "", newline ? "\n" : "");
 }
 
 truck_lane_t new_truck_lane() {
     truck_lane_t res;
-    res.trucks = NULL;
+    res.trucks = (truck_t**)shared_malloc(TRUCK_LANE_CAPACITY * sizeof(truck_t*));
+    passert_neq(truck_t**, "%p", res.trucks, NULL);
+    res.keys = (lane_key_t*)shared_calloc(lane_keys_size(TRUCK_LANE_CAPACITY), sizeof(lane_key_t));
+    res.n_trucks = 0;
+    res.capacity = TRUCK_LANE_CAPACITY;
     return res;
 }
 
 void truck_lane_push(truck_lane_t* lane, truck_t* truck) {
-    struct truck_ll* entry = malloc(sizeof(struct truck_ll));
-
-    entry->next = lane->trucks;
-    entry->truck = truck;
+    if (lane->n_trucks == lane->capacity) {
+        size_t capacity = lane->capacity * 2;
+        truck_t** trucks = (truck_t**)shared_realloc(lane->trucks, capacity * sizeof(truck_t*));
+        passert_neq(truck_t**, "%p", trucks, NULL, "Couldn't allocate %zu bytes of memory", capacity * sizeof(truck_t*));
+
+        lane->trucks = trucks;
+        lane->keys = (lane_key_t*)shared_realloc(lane->keys, lane_keys_size(capacity) * sizeof(lane_key_t));
+        lane->capacity = capacity;
+    }
 
-    lane->trucks = entry;
+    lane->trucks[lane->n_trucks] = truck;
+    lane->keys[lane->n_trucks] = lane_key(truck->destination, !truck->loading, truck_is_empty(truck));
+    lane->n_trucks++;
 }
 
 void free_truck_lane(truck_lane_t* truck_lane) {
-    struct truck_ll* current = truck_lane->trucks;
-    while (current != NULL) {
-        struct truck_ll* tmp = current;
-        current = tmp->next;
-        free(tmp);
-    }
+    shared_free(truck_lane->trucks);
+    shared_free(truck_lane->keys);
+    truck_lane->trucks = NULL;
+    truck_lane->keys = NULL;
+    truck_lane->n_trucks = 0;
+    truck_lane->capacity = 0;
 }
 
 void truck_lane_print(truck_lane_t* lane, bool short_version) {
     printf("TruckLane [\n");
 
-    struct truck_ll* current = lane->trucks;
-    while (current != NULL) {
-        truck_t* truck = current->truck;
+    for (size_t n = 0; n < lane->n_trucks; n++) {
+        truck_t* truck = lane->trucks[n];
         printf("  ");
         if (short_version) {
             if (truck->loading) printf("»");
             else printf("«");
 
-            if (truck->container.is_empty) printf("(-)");
-            else if (truck->container.container.destination == truck->destination) {
-                printf("(v)");
-            } else {
-                printf("(x)");
+            for (size_t o = 0; o < TRUCK_CONTAINERS; o++) {
+                if (container_holder_is_empty(&truck->containers[o])) printf("(-)");
+                else if (truck->containers[o].container.destination == truck->destination) {
+                    printf("(v)");
+                } else {
+                    printf("(x)");
+                }
             }
 
             printf(" -> %s (%zu),\n", DESTINATION_NAMES[truck->destination], truck->destination);
         } else {
-            print_container_holder(&truck->container, false);
+            truck_print_containers(truck, false);
             printf(",\n");
         }
-        current = current->next;
     }
 
     printf("]\n");
 }
 
 truck_t* truck_lane_accepts(truck_lane_t* lane, size_t destination) {
-    struct truck_ll* current = lane->trucks;
-
-    while (current != NULL) {
-        truck_t* truck = current->truck;
-
-        if (truck->loading && truck->destination == destination) return truck;
+    // Only the loading trucks have room for a container
+    size_t n = lane_match_accepts(lane->keys, lane->n_trucks, destination);
+    return n < lane->n_trucks ? lane->trucks[n] : NULL;
+}
 
-        current = current->next;
-    }
+size_t truck_lane_next_accepting(truck_lane_t* lane, size_t destination, size_t from) {
+    return lane_match_next_accepting(lane->keys, from, lane->n_trucks, destination);
+}
 
-    return NULL;
+size_t truck_lane_next_cargo(truck_lane_t* lane, size_t from) {
+    return lane_match_next(lane->keys, from, lane->n_trucks, LANE_KEY_FULL | LANE_KEY_EMPTY, LANE_KEY_FULL);
 }
 
 bool truck_lane_remove(truck_lane_t* lane, truck_t* truck) {
     passert_neq(truck_t*, "%p", truck, NULL);
-    struct truck_ll* current = lane->trucks;
-
-    if (current == NULL) return false;
-
-    if (current->truck == truck) {
-        lane->trucks = current->next;
-        return true;
-    }
 
-    while (current != NULL && current->next != NULL) {
-        if (current->next->truck == truck) {
-            current->next = current->next->next;
+    for (size_t n = 0; n < lane->n_trucks; n++) {
+        if (lane->trucks[n] == truck) {
+            lane->n_trucks--;
+            lane->trucks[n] = lane->trucks[lane->n_trucks];
+            lane->keys[n] = lane->keys[lane->n_trucks];
             return true;
         }
-        current = current->next;
     }
 
     return false;
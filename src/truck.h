@@ -8,10 +8,18 @@ Contains the truck_t type.
 #define TRUCK_H
 
 #include "container.h"
+#include "vehicle.h"
+#include "lane_match.h"
 #include <stdbool.h>
 
+/// The number of containers that a truck carries;
+/// can be overriden at compile time with `make DEFINES="TRUCK_CONTAINERS=2"`
+#ifndef TRUCK_CONTAINERS
+#define TRUCK_CONTAINERS 1
+#endif
+
 struct truck {
-    container_holder_t container;
+    container_holder_t containers[TRUCK_CONTAINERS];
 
     /// Guaranteed to be a valid DESTINATION_NAMES index
     size_t destination;
@@ -19,10 +27,15 @@ struct truck {
     bool loading;
 
     unsigned char ulid[16];
+
+    /// When the truck arrived on the platform, in seconds on the control tower's clock
+    double arrived;
 };
 typedef struct truck truck_t;
 
-/// Creates a new truck
+VEHICLE(truck, truck_t, TRUCK_CONTAINERS)
+
+/// Creates a new truck, carrying containers for other destinations
 truck_t new_truck(size_t destination);
 
 /// Creates a new, empty truck
@@ -31,15 +44,18 @@ truck_t empty_truck(size_t destination);
 /// Used for debugging
 void print_truck(truck_t* truck, bool newline);
 
-struct truck_ll {
-    /// Exclusive ownership of the truck is guaranteed
-    truck_t* truck;
-
-    struct truck_ll* next;
-};
+/// Initial capacity of a truck lane; the lane grows (by doubling its capacity) if more trucks park in it
+#define TRUCK_LANE_CAPACITY 16
 
+/// Dense array of the trucks parked in the lane, from which trucks are removed by swapping them with the last one.
+/// Exclusive ownership of the trucks in the lane is guaranteed
 struct truck_lane {
-    struct truck_ll* trucks;
+    truck_t** trucks;
+    /// The key of each truck (see `lane_match.h`); it doesn't change while the truck is parked in the lane,
+    /// since loading trucks leave once full and unloading trucks leave once empty
+    lane_key_t* keys;
+    size_t n_trucks;
+    size_t capacity;
 };
 typedef struct truck_lane truck_lane_t;
 
@@ -48,7 +64,7 @@ truck_lane_t new_truck_lane();
 
 void free_truck_lane(truck_lane_t* truck_lane);
 
-/// Adds a truck to the truck lane
+/// Adds a truck to the truck lane; only allocates if the lane is full
 void truck_lane_push(truck_lane_t* lane, truck_t* truck);
 
 /// Prints the truck lane, used for debugging
@@ -58,7 +74,15 @@ void truck_lane_print(truck_lane_t* lane, bool short_version);
 /// If none are found, returns NULL
 truck_t* truck_lane_accepts(truck_lane_t* lane, size_t destination);
 
-/// Removes a truck from the truck lane, returns true iff it was present and removed
+/// Returns the index of the first truck at or after `from` that can accept a container with destination `destination`,
+/// or `lane->n_trucks` if there are none
+size_t truck_lane_next_accepting(truck_lane_t* lane, size_t destination, size_t from);
+
+/// Returns the index of the first truck at or after `from` with a container to unload, or `lane->n_trucks` if there are none
+size_t truck_lane_next_cargo(truck_lane_t* lane, size_t from);
+
+/// Removes a truck from the truck lane, returns true iff it was present and removed.
+/// The last truck of the lane takes the place of the removed truck
 bool truck_lane_remove(truck_lane_t* lane, truck_t* truck);
 
 #endif // TRUCK_H
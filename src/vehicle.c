@@ -0,0 +1,36 @@
+#include "vehicle.h"
+#include "assert.h"
+#include "ulid.h"
+
+void vehicle_fill(container_holder_t* holders, size_t capacity, size_t destination, size_t n_cargo) {
+    passert_lt(size_t, "%zu", destination, N_DESTINATIONS);
+
+    size_t n = 0;
+    for (; n < n_cargo && n < capacity; n++) { // fill the n_cargo first elements with random destinations
+        size_t dest = rand() % N_DESTINATIONS;
+        if (dest == destination && N_DESTINATIONS > 1) {
+            // (X ~> U[0; n[) + (Y ~> U[0; n[) ~> U[0; n[ in the finite field (ℕ mod n)
+            dest = (dest + rand() % (N_DESTINATIONS - 1)) % N_DESTINATIONS;
+        }
+        holders[n] = new_container_holder(false, dest);
+    }
+    for (; n < capacity; n++) { // fill the other elements with empty slots
+        holders[n] = new_container_holder(true, 0);
+    }
+}
+
+void vehicle_new_ulid(unsigned char ulid[16]) {
+    struct ulid_generator* generator = get_generator();
+
+    char encoded[27];
+    ulid_generate(generator, encoded);
+    ulid_decode(ulid, encoded);
+}
+
+void vehicle_print_containers(const container_holder_t* holders, size_t capacity, bool newline) {
+    for (size_t n = 0; n < capacity; n++) {
+        if (newline) printf("  ");
+        print_container_holder(&holders[n], false);
+        if (n < capacity - 1) printf(", %s", newline ? "\n" : "");
+    }
+}
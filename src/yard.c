@@ -0,0 +1,71 @@
+#include "yard.h"
+#include <stdio.h>
+#include "assert.h"
+
+yard_t new_yard(size_t height) {
+    passert(height <= YARD_MAX_HEIGHT, "Stacks of a yard may not be higher than %d", YARD_MAX_HEIGHT);
+
+    yard_t res;
+    for (size_t d = 0; d < N_DESTINATIONS; d++) {
+        for (size_t n = 0; n < YARD_MAX_HEIGHT; n++) {
+            res.stacks[d][n] = new_container_holder(true, 0);
+        }
+        res.heights[d] = 0;
+    }
+    res.height = height;
+
+    res.staged = 0;
+    res.rehandles = 0;
+    res.full = 0;
+    res.high_water = 0;
+
+    return res;
+}
+
+size_t yard_length(const yard_t* yard) {
+    size_t res = 0;
+    for (size_t d = 0; d < N_DESTINATIONS; d++) {
+        res += yard->heights[d];
+    }
+    return res;
+}
+
+bool yard_stage(yard_t* yard, container_holder_t* holder) {
+    size_t destination = holder->container.destination;
+    if (yard->heights[destination] >= yard->height) return false;
+
+    transfer_container(holder, &yard->stacks[destination][yard->heights[destination]]);
+    yard->heights[destination]++;
+    yard->staged++;
+    if (yard->heights[destination] == yard->height) yard->full++;
+    if (yard->heights[destination] > yard->high_water) yard->high_water = yard->heights[destination];
+
+    return true;
+}
+
+container_holder_t* yard_top(yard_t* yard, size_t destination) {
+    if (yard->heights[destination] == 0) return NULL;
+    return &yard->stacks[destination][yard->heights[destination] - 1];
+}
+
+void yard_pop(yard_t* yard, size_t destination) {
+    passert(yard->heights[destination] > 0, "Popped an empty stack of the yard");
+    passert(container_holder_is_empty(yard_top(yard, destination)), "Popped a container that is still in the yard");
+
+    yard->heights[destination]--;
+    yard->rehandles++;
+}
+
+void yard_print(const char* prefix, const char* name, const yard_t* yard) {
+    printf(
+        "%sYard %s: %zu staged, %zu rehandled, %zu left, highest stack: %zu/%zu, stacks filled up %zu times\n",
+        prefix,
+        name,
+        yard->staged,
+        yard->rehandles,
+        yard_length(yard),
+        yard->high_water,
+        yard->height,
+        yard->full
+    );
+}
@@ -0,0 +1,62 @@
+/*! # yard.h
+
+Container yard next to each crane, enabled with `--yard <height>`.
+
+Without a yard, a crane holding a container that no vehicle can take leaves it where it is: a boat keeps its cargo and
+gets cycled back in the boat lane, a truck or a wagon keeps waiting, and once every vehicle is waiting for a destination
+that doesn't show up, both cranes are stuck.
+With a yard, `crane_unload` stages such containers instead, on one stack per destination, so that their vehicle can
+leave; the crane then loads them from the top of the stacks onto the vehicles for their destination as they show up.
+
+Each stack holds at most `height` containers, so that the yard doesn't grow without bound: a container whose stack is
+full stays where it is, as without a yard.
+Staging a container costs a second move before it reaches its vehicle; the yard counts these rehandles.
+*/
+
+#ifndef YARD_H
+#define YARD_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "container.h"
+
+/// The highest that the stacks of a yard may be
+#define YARD_MAX_HEIGHT 16
+
+struct yard {
+    /// One stack per destination, from the bottom to the top
+    container_holder_t stacks[N_DESTINATIONS][YARD_MAX_HEIGHT];
+    size_t heights[N_DESTINATIONS];
+
+    /// How many containers each stack may hold, 0 if the crane has no yard
+    size_t height;
+
+    /// The number of containers staged in the yard, and of containers loaded back from it onto a vehicle
+    size_t staged;
+    size_t rehandles;
+    /// The number of times that a stack filled up (after which containers for its destination stay on their vehicles),
+    /// and the highest that a stack got
+    size_t full;
+    size_t high_water;
+};
+typedef struct yard yard_t;
+
+/// Creates an empty yard, whose stacks hold at most `height` containers (0 for no yard)
+yard_t new_yard(size_t height);
+
+/// Returns the number of containers in the yard
+size_t yard_length(const yard_t* yard);
+
+/// Moves the container of `holder` onto the stack of its destination; returns false if the stack is full
+bool yard_stage(yard_t* yard, container_holder_t* holder);
+
+/// Returns the holder at the top of the stack of `destination`, or NULL if the stack is empty
+container_holder_t* yard_top(yard_t* yard, size_t destination);
+
+/// Removes the top of the stack of `destination`, once its container was moved onto a vehicle
+void yard_pop(yard_t* yard, size_t destination);
+
+/// Prints what went through the yard of the crane `name`
+void yard_print(const char* prefix, const char* name, const yard_t* yard);
+
+#endif // YARD_H
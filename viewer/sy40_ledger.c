@@ -0,0 +1,106 @@
+/*! # sy40_ledger.c
+
+Queries the ledger of moves saved by `sy40_project --ledger <file>` (see `src/ledger.h`).
+The ledger is mapped rather than parsed, and is sorted by time, so time windows are found with a binary search.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <ulid.h>
+#include "../src/ledger.h"
+
+void print_usage(const char* name) {
+    printf("Usage: %s [OPTIONS] <file>\n", name);
+    printf("\n");
+    printf("Prints a summary of the ledger, or the moves selected by the options below.\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -f, --from <ms>          Prints the moves made at least <ms> milliseconds after the first one\n");
+    printf("  -t, --to <ms>            Prints the moves made less than <ms> milliseconds after the first one\n");
+    printf("  -c, --container <ulid>   Prints the moves of the container <ulid>\n");
+    printf("  -h, --help               Prints this message\n");
+}
+
+/// Parses a non-negative number of milliseconds into nanoseconds, returns false if `arg` isn't one
+bool parse_millis(const char* arg, uint64_t* res) {
+    char* end;
+    double millis = strtod(arg, &end);
+    if (*arg == '\0' || *end != '\0' || !(millis >= 0)) return false;
+    *res = (uint64_t)(millis * 1e6);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    bool window = false;
+    const char* container = NULL;
+
+    static struct option options[] = {
+        {"from", required_argument, NULL, 'f'},
+        {"to", required_argument, NULL, 't'},
+        {"container", required_argument, NULL, 'c'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "f:t:c:h", options, NULL)) != -1) {
+        switch (option) {
+            case 'f':
+            case 't':
+                if (!parse_millis(optarg, option == 'f' ? &from : &to)) {
+                    fprintf(stderr, "Invalid time: '%s'\n", optarg);
+                    return 1;
+                }
+                window = true;
+                break;
+            case 'c':
+                container = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    ledger_view_t view = ledger_view_load(argv[optind]);
+    uint64_t origin = view.length > 0 ? view.entries[0].time : 0;
+
+    if (container != NULL) {
+        unsigned char ulid[16];
+        if (strlen(container) != 26 || ulid_decode(ulid, container) != 0) {
+            fprintf(stderr, "Invalid ULID: '%s'\n", container);
+            return 1;
+        }
+
+        ledger_view_sort_by_container(&view);
+        size_t begin, end;
+        ledger_view_container_range(&view, ulid, &begin, &end);
+        for (size_t n = begin; n < end; n++) {
+            print_ledger_entry(&view.by_container[n], origin);
+        }
+        printf("%zu moves\n", end - begin);
+    } else if (window) {
+        size_t begin, end;
+        ledger_view_time_range(&view, origin + from, to == UINT64_MAX ? UINT64_MAX : origin + to, &begin, &end);
+        for (size_t n = begin; n < end; n++) {
+            print_ledger_entry(&view.entries[n], origin);
+        }
+        printf("%zu moves\n", end - begin);
+    } else {
+        ledger_view_print(&view);
+    }
+
+    free_ledger_view(&view);
+    return 0;
+}
@@ -0,0 +1,197 @@
+/*! # sy40_top.c
+
+A `top`-like viewer for the live statistics published by a running `sy40_project` (see `src/stats.h`).
+It only maps the statistics segment read-only, so it doesn't slow the platform down.
+With `--locate <ulid>`, it instead asks the running platform where a container is (see `stats_locate`), and exits.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ulid.h>
+#include "../src/stats.h"
+
+void print_usage(const char* name) {
+    printf("Usage: %s [OPTIONS]\n", name);
+    printf("\n");
+    printf("Options:\n");
+    printf("  -s, --stats <name>       Reads the statistics from the shared memory segment <name> (default: %s)\n", STATS_DEFAULT_NAME);
+    printf("  -i, --interval <millis>  Refresh interval, in milliseconds (default: 500)\n");
+    printf("  -1, --once               Prints the statistics once and exits\n");
+    printf("  -l, --locate <ulid>      Prints where the container <ulid> is on the running platform and exits\n");
+    printf("  -h, --help               Prints this message\n");
+}
+
+void print_crane_stats(const char* name, const crane_stats_t* stats) {
+    printf(
+        "%-8s %10zu %10zu %8zu %8zu %8zu %8zu %8zu %10zu\n",
+        name,
+        stats_get(&stats->moves),
+        stats_get(&stats->messages),
+        stats_get(&stats->queue.depth),
+        stats_get(&stats->boats_queued),
+        stats_get(&stats->wagons),
+        stats_get(&stats->trucks),
+        stats_get(&stats->boats_cycled),
+        stats_get(&stats->lock_waits)
+    );
+}
+
+void print_queue_stats(const char* name, const queue_stats_t* stats) {
+    printf(
+        "%-8s %8zu %8zu %8zu %8zu",
+        name,
+        stats_get(&stats->depth),
+        stats_get(&stats->high_water),
+        stats_get(&stats->waited),
+        stats_get(&stats->shed)
+    );
+    for (size_t type = 0; type < STATS_MESSAGE_TYPES; type++) {
+        size_t received = stats_get(&stats->received[type]);
+        if (received == 0) continue;
+        printf(
+            "  %s %.3f/%.3f",
+            stats_message_type_name(type),
+            stats_get(&stats->wait[type]) / (double)received / 1e6,
+            stats_get(&stats->max_wait[type]) / 1e6
+        );
+    }
+    printf("\n");
+}
+
+void print_stats(const char* name, const platform_stats_t* stats) {
+    printf(
+        "sy40_top - %s - pid %d - %s\n\n",
+        name,
+        (int)stats->pid,
+        atomic_load((atomic_bool*)&stats->running) ? "running" : "stopped"
+    );
+
+    printf(
+        "%-8s %10s %10s %8s %8s %8s %8s %8s %10s\n",
+        "CRANE", "MOVES", "MESSAGES", "QUEUE", "BOATS", "WAGONS", "TRUCKS", "CYCLED", "LOCK WAITS"
+    );
+    print_crane_stats("alpha", &stats->alpha);
+    print_crane_stats("beta", &stats->beta);
+
+    printf("\n");
+    printf(
+        "%-8s %10s %8s %8s %8s %8s %8s %8s\n",
+        "TOWER", "MESSAGES", "QUEUE", "BOATS", "TRAINS", "TRUCKS =>", "BOATS =>", "TRAINS =>"
+    );
+    printf(
+        "%-8s %10zu %8zu %8zu %8zu %9zu %8zu %9zu\n",
+        "gamma",
+        stats_get(&stats->tower.messages),
+        stats_get(&stats->tower.queue.depth),
+        stats_get(&stats->tower.boats_in_use),
+        stats_get(&stats->tower.trains_in_use),
+        stats_get(&stats->tower.trucks_departed),
+        stats_get(&stats->tower.boats_departed),
+        stats_get(&stats->tower.trains_departed)
+    );
+
+    printf("\n");
+    printf("%-8s %8s %8s %8s %8s  %s\n", "QUEUE", "DEPTH", "HIGH", "WAITED", "SHED", "WAIT AVG/MAX (ms)");
+    print_queue_stats("alpha", &stats->alpha.queue);
+    print_queue_stats("beta", &stats->beta.queue);
+    print_queue_stats("gamma", &stats->tower.queue);
+}
+
+/// Asks the platform publishing `name` where the container `container` is
+int locate(const char* name, const char* container) {
+    unsigned char ulid[16];
+    if (strlen(container) != 26 || ulid_decode(ulid, container) != 0) {
+        fprintf(stderr, "Invalid ULID: '%s'\n", container);
+        return 1;
+    }
+
+    stats_location_t location;
+    if (!stats_locate(name, ulid, &location)) {
+        fprintf(stderr, "No running platform answered on %s\n", name);
+        return 1;
+    }
+
+    if (location.found) {
+        printf(
+            "%s: %s %#" PRIx64 ", slot %" PRIu64 "\n",
+            container,
+            location.place,
+            location.vehicle,
+            location.slot
+        );
+    } else {
+        printf("%s: not on the platform\n", container);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* name = STATS_DEFAULT_NAME;
+    long interval = 500;
+    bool once = false;
+    const char* container = NULL;
+
+    static struct option options[] = {
+        {"stats", required_argument, NULL, 's'},
+        {"interval", required_argument, NULL, 'i'},
+        {"once", no_argument, NULL, '1'},
+        {"locate", required_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "s:i:1l:h", options, NULL)) != -1) {
+        switch (option) {
+            case 's':
+                name = optarg;
+                break;
+            case 'i':
+                interval = strtol(optarg, NULL, 10);
+                if (interval <= 0) interval = 500;
+                break;
+            case '1':
+                once = true;
+                break;
+            case 'l':
+                container = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (container != NULL) return locate(name, container);
+
+    const platform_stats_t* stats = NULL;
+    while (stats == NULL) {
+        stats = stats_open(name);
+        if (stats != NULL) break;
+        if (once) {
+            fprintf(stderr, "No statistics segment named %s\n", name);
+            return 1;
+        }
+        printf("\x1b[H\x1b[2JWaiting for %s...\n", name);
+        fflush(stdout);
+        usleep(interval * 1000);
+    }
+
+    while (true) {
+        if (!once) printf("\x1b[H\x1b[2J");
+        print_stats(name, stats);
+        fflush(stdout);
+
+        if (once || !atomic_load((atomic_bool*)&stats->running)) break;
+        usleep(interval * 1000);
+    }
+
+    stats_close(stats);
+    return 0;
+}